@@ -560,6 +560,26 @@ class Runner():
             raise AssertionError(msg)
 
 
+##################################################################
+# Benchmarks
+#
+
+__all__ += ["bench_results"]
+
+def bench_results(text):
+    """Collect the 'bench: <name> key=value ...' lines printed by
+    benchmark programs such as threadbench.  Returns a list of dicts
+    with the benchmark name under 'name' and every value as an int."""
+
+    results = []
+    for m in re.finditer(r"^bench: (\S+)((?: \w+=-?\d+)*)\s*$", text, re.M):
+        result = {"name": m.group(1)}
+        for k, v in re.findall(r"(\w+)=(-?\d+)", m.group(2)):
+            result[k] = int(v)
+        results.append(result)
+    return results
+
+
 ##################################################################
 # Monitors
 #
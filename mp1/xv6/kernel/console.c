@@ -17,6 +17,7 @@
 #include "sleeplock.h"
 #include "fs.h"
 #include "file.h"
+#include "poll.h"
 #include "memlayout.h"
 #include "riscv.h"
 #include "defs.h"
@@ -128,6 +129,23 @@ consoleread(int user_dst, uint64 dst, int n)
   return target - n;
 }
 
+//
+// poll() on the console: input is ready once a whole
+// line (or end-of-file) has arrived; output never blocks.
+//
+int
+consolepoll(int events)
+{
+  int revents = events & POLLOUT;
+
+  acquire(&cons.lock);
+  if((events & POLLIN) && cons.r != cons.w)
+    revents |= POLLIN;
+  release(&cons.lock);
+
+  return revents;
+}
+
 //
 // the console input interrupt handler.
 // uartintr() calls this for input character.
@@ -172,6 +190,7 @@ consoleintr(int c)
         // has arrived.
         cons.w = cons.e;
         wakeup(&cons.r);
+        pollwakeup();
       }
     }
     break;
@@ -191,4 +210,5 @@ consoleinit(void)
   // to consoleread and consolewrite.
   devsw[CONSOLE].read = consoleread;
   devsw[CONSOLE].write = consolewrite;
+  devsw[CONSOLE].poll = consolepoll;
 }
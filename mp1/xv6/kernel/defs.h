@@ -33,6 +33,11 @@ void            fileinit(void);
 int             fileread(struct file*, uint64, int n);
 int             filestat(struct file*, uint64 addr);
 int             filewrite(struct file*, uint64, int n);
+int             filepoll(struct file*, int events);
+uint            pollgen(void);
+void            pollsleep(uint gen, int timed);
+void            pollwakeup(void);
+void            polltick(void);
 
 // fs.c
 void            fsinit(int);
@@ -73,8 +78,9 @@ void            end_op(void);
 // pipe.c
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
-int             piperead(struct pipe*, uint64, int);
-int             pipewrite(struct pipe*, uint64, int);
+int             piperead(struct pipe*, uint64, int, int);
+int             pipewrite(struct pipe*, uint64, int, int);
+int             pipepoll(struct pipe*, int, int);
 
 // printf.c
 void            printf(char*, ...);
@@ -12,6 +12,7 @@
 #include "file.h"
 #include "stat.h"
 #include "proc.h"
+#include "poll.h"
 
 struct devsw devsw[NDEV];
 struct {
@@ -19,10 +20,22 @@ struct {
   struct file file[NFILE];
 } ftable;
 
+// poll() sleepers wait on gen, which is bumped whenever
+// a pipe or the console may have become ready. Sleepers
+// with a timeout wait on ntimed instead, which the clock
+// also wakes, so a poll with no timeout sleeps until an
+// fd event.
+struct {
+  struct spinlock lock;
+  uint gen;
+  int ntimed;   // sleepers with a timeout
+} pollstate;
+
 void
 fileinit(void)
 {
   initlock(&ftable.lock, "ftable");
+  initlock(&pollstate.lock, "poll");
 }
 
 // Allocate a file structure.
@@ -35,6 +48,7 @@ filealloc(void)
   for(f = ftable.file; f < ftable.file + NFILE; f++){
     if(f->ref == 0){
       f->ref = 1;
+      f->nonblock = 0;
       release(&ftable.lock);
       return f;
     }
@@ -112,10 +126,13 @@ fileread(struct file *f, uint64 addr, int n)
     return -1;
 
   if(f->type == FD_PIPE){
-    r = piperead(f->pipe, addr, n);
+    r = piperead(f->pipe, addr, n, f->nonblock);
   } else if(f->type == FD_DEVICE){
     if(f->major < 0 || f->major >= NDEV || !devsw[f->major].read)
       return -1;
+    if(f->nonblock && devsw[f->major].poll &&
+       (devsw[f->major].poll(POLLIN) & POLLIN) == 0)
+      return -1;
     r = devsw[f->major].read(1, addr, n);
   } else if(f->type == FD_INODE){
     ilock(f->ip);
@@ -140,7 +157,7 @@ filewrite(struct file *f, uint64 addr, int n)
     return -1;
 
   if(f->type == FD_PIPE){
-    ret = pipewrite(f->pipe, addr, n);
+    ret = pipewrite(f->pipe, addr, n, f->nonblock);
   } else if(f->type == FD_DEVICE){
     if(f->major < 0 || f->major >= NDEV || !devsw[f->major].write)
       return -1;
@@ -180,3 +197,76 @@ filewrite(struct file *f, uint64 addr, int n)
   return ret;
 }
 
+
+// Report which of events would not block on file f.
+// Inodes are always ready.
+int
+filepoll(struct file *f, int events)
+{
+  int revents;
+
+  if(f->type == FD_PIPE)
+    return pipepoll(f->pipe, f->writable, events);
+
+  if(f->type == FD_DEVICE && f->major >= 0 && f->major < NDEV &&
+     devsw[f->major].poll)
+    revents = devsw[f->major].poll(events);
+  else
+    revents = events & (POLLIN|POLLOUT);
+
+  if(f->readable == 0)
+    revents &= ~POLLIN;
+  if(f->writable == 0)
+    revents &= ~POLLOUT;
+  return revents;
+}
+
+uint
+pollgen(void)
+{
+  uint gen;
+
+  acquire(&pollstate.lock);
+  gen = pollstate.gen;
+  release(&pollstate.lock);
+  return gen;
+}
+
+// Sleep until pollwakeup() has been called since gen was read,
+// or if timed, until the next clock tick.
+void
+pollsleep(uint gen, int timed)
+{
+  acquire(&pollstate.lock);
+  if(pollstate.gen == gen){
+    if(timed){
+      pollstate.ntimed++;
+      sleep(&pollstate.ntimed, &pollstate.lock);
+      pollstate.ntimed--;
+    } else {
+      sleep(&pollstate.gen, &pollstate.lock);
+    }
+  }
+  release(&pollstate.lock);
+}
+
+void
+pollwakeup(void)
+{
+  acquire(&pollstate.lock);
+  pollstate.gen++;
+  wakeup(&pollstate.gen);
+  if(pollstate.ntimed > 0)
+    wakeup(&pollstate.ntimed);
+  release(&pollstate.lock);
+}
+
+// Called on every clock tick: let timed sleepers check their timeout.
+void
+polltick(void)
+{
+  acquire(&pollstate.lock);
+  if(pollstate.ntimed > 0)
+    wakeup(&pollstate.ntimed);
+  release(&pollstate.lock);
+}
@@ -3,6 +3,7 @@ struct file {
   int ref; // reference count
   char readable;
   char writable;
+  char nonblock;     // O_NONBLOCK: read/write return -1 instead of sleeping
   struct pipe *pipe; // FD_PIPE
   struct inode *ip;  // FD_INODE and FD_DEVICE
   uint off;          // FD_INODE
@@ -33,6 +34,7 @@ struct inode {
 struct devsw {
   int (*read)(int, uint64, int);
   int (*write)(int, uint64, int);
+  int (*poll)(int);  // returns the subset of POLLIN|POLLOUT that is ready
 };
 
 extern struct devsw devsw[];
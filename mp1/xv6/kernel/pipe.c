@@ -7,6 +7,7 @@
 #include "fs.h"
 #include "sleeplock.h"
 #include "file.h"
+#include "poll.h"
 
 #define PIPESIZE 512
 
@@ -66,6 +67,7 @@ pipeclose(struct pipe *pi, int writable)
     pi->readopen = 0;
     wakeup(&pi->nwrite);
   }
+  pollwakeup();
   if(pi->readopen == 0 && pi->writeopen == 0){
     release(&pi->lock);
     kfree((char*)pi);
@@ -73,8 +75,10 @@ pipeclose(struct pipe *pi, int writable)
     release(&pi->lock);
 }
 
+// if nonblock is set, return what fits instead of sleeping
+// on a full pipe, or -1 if nothing could be written.
 int
-pipewrite(struct pipe *pi, uint64 addr, int n)
+pipewrite(struct pipe *pi, uint64 addr, int n, int nonblock)
 {
   int i;
   char ch;
@@ -87,20 +91,29 @@ pipewrite(struct pipe *pi, uint64 addr, int n)
         release(&pi->lock);
         return -1;
       }
+      if(nonblock)
+        goto done;
       wakeup(&pi->nread);
+      pollwakeup();
       sleep(&pi->nwrite, &pi->lock);
     }
     if(copyin(pr->pagetable, &ch, addr + i, 1) == -1)
       break;
     pi->data[pi->nwrite++ % PIPESIZE] = ch;
   }
+done:
   wakeup(&pi->nread);
+  pollwakeup();
   release(&pi->lock);
+  if(nonblock && i == 0 && n > 0)
+    return -1;
   return i;
 }
 
+// if nonblock is set, return -1 instead of sleeping
+// on an empty pipe whose write end is still open.
 int
-piperead(struct pipe *pi, uint64 addr, int n)
+piperead(struct pipe *pi, uint64 addr, int n, int nonblock)
 {
   int i;
   struct proc *pr = myproc();
@@ -108,7 +121,7 @@ piperead(struct pipe *pi, uint64 addr, int n)
 
   acquire(&pi->lock);
   while(pi->nread == pi->nwrite && pi->writeopen){  //DOC: pipe-empty
-    if(pr->killed){
+    if(pr->killed || nonblock){
       release(&pi->lock);
       return -1;
     }
@@ -122,6 +135,29 @@ piperead(struct pipe *pi, uint64 addr, int n)
       break;
   }
   wakeup(&pi->nwrite);  //DOC: piperead-wakeup
+  pollwakeup();
   release(&pi->lock);
   return i;
 }
+
+// report which of events would not block on this end of the pipe.
+int
+pipepoll(struct pipe *pi, int writable, int events)
+{
+  int revents = 0;
+
+  acquire(&pi->lock);
+  if(writable){
+    if(pi->readopen == 0)
+      revents |= POLLHUP;
+    else if((events & POLLOUT) && pi->nwrite != pi->nread + PIPESIZE)
+      revents |= POLLOUT;
+  } else {
+    if((events & POLLIN) && pi->nread != pi->nwrite)
+      revents |= POLLIN;
+    if(pi->writeopen == 0)
+      revents |= POLLHUP;
+  }
+  release(&pi->lock);
+  return revents;
+}
@@ -0,0 +1,11 @@
+// poll() event bits, shared by the kernel and user programs.
+#define POLLIN   0x001  // data can be read without blocking
+#define POLLOUT  0x004  // data can be written without blocking
+#define POLLHUP  0x010  // the other end of a pipe has been closed
+#define POLLNVAL 0x020  // fd is not an open file
+
+struct pollfd {
+  int fd;         // file descriptor to check, ignored if negative
+  short events;   // requested events
+  short revents;  // returned events
+};
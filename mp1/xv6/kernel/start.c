@@ -41,6 +41,11 @@ start()
   // ask for clock interrupts.
   timerinit();
 
+  // let supervisor and user mode read the time CSR (rdtime),
+  // for cycle-level measurements in user programs.
+  w_mcounteren(r_mcounteren() | 2);
+  w_scounteren(r_scounteren() | 2);
+
   // keep each CPU's hartid in its tp register, for cpuid().
   int id = r_mhartid();
   w_tp(id);
@@ -15,6 +15,7 @@
 #include "sleeplock.h"
 #include "file.h"
 #include "fcntl.h"
+#include "poll.h"
 
 // Fetch the nth word-sized system call argument as a file descriptor
 // and return both the descriptor and the corresponding struct file.
@@ -340,6 +341,7 @@ sys_open(void)
   f->ip = ip;
   f->readable = !(omode & O_WRONLY);
   f->writable = (omode & O_WRONLY) || (omode & O_RDWR);
+  f->nonblock = (omode & O_NONBLOCK) != 0;
 
   if((omode & O_TRUNC) && ip->type == T_FILE){
     itrunc(ip);
@@ -484,3 +486,89 @@ sys_pipe(void)
   }
   return 0;
 }
+
+uint64
+sys_fcntl(void)
+{
+  struct file *f;
+  int cmd, arg, flags;
+
+  if(argfd(0, 0, &f) < 0 || argint(1, &cmd) < 0 || argint(2, &arg) < 0)
+    return -1;
+
+  switch(cmd){
+  case F_GETFL:
+    if(f->readable && f->writable)
+      flags = O_RDWR;
+    else if(f->writable)
+      flags = O_WRONLY;
+    else
+      flags = O_RDONLY;
+    if(f->nonblock)
+      flags |= O_NONBLOCK;
+    return flags;
+  case F_SETFL:
+    f->nonblock = (arg & O_NONBLOCK) != 0;
+    return 0;
+  }
+  return -1;
+}
+
+// wait until one of the fds is ready, or timeout ticks
+// have passed (timeout < 0 waits forever, 0 never sleeps).
+// returns the number of fds with non-zero revents.
+uint64
+sys_poll(void)
+{
+  uint64 fdsaddr;
+  int nfds, timeout, i, n;
+  struct pollfd fds[NOFILE];
+  struct proc *p = myproc();
+  struct file *f;
+  uint ticks0, gen;
+
+  if(argaddr(0, &fdsaddr) < 0 || argint(1, &nfds) < 0 || argint(2, &timeout) < 0)
+    return -1;
+  if(nfds < 0 || nfds > NOFILE)
+    return -1;
+  if(copyin(p->pagetable, (char*)fds, fdsaddr, nfds*sizeof(struct pollfd)) < 0)
+    return -1;
+
+  acquire(&tickslock);
+  ticks0 = ticks;
+  release(&tickslock);
+
+  for(;;){
+    // read gen before checking, so that a wakeup that
+    // races with the checks below is not lost.
+    gen = pollgen();
+    n = 0;
+    for(i = 0; i < nfds; i++){
+      fds[i].revents = 0;
+      if(fds[i].fd < 0)
+        continue;
+      if(fds[i].fd >= NOFILE || (f = p->ofile[fds[i].fd]) == 0)
+        fds[i].revents = POLLNVAL;
+      else
+        fds[i].revents = filepoll(f, fds[i].events);
+      if(fds[i].revents)
+        n++;
+    }
+    if(n > 0 || timeout == 0)
+      break;
+    if(timeout > 0){
+      acquire(&tickslock);
+      i = ticks - ticks0 >= timeout;
+      release(&tickslock);
+      if(i)
+        break;
+    }
+    if(p->killed)
+      return -1;
+    pollsleep(gen, timeout > 0);
+  }
+
+  if(copyout(p->pagetable, fdsaddr, (char*)fds, nfds*sizeof(struct pollfd)) < 0)
+    return -1;
+  return n;
+}
@@ -0,0 +1,59 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/threads.h"
+
+#define NULL 0
+
+static int fds[2];
+
+void reader(void *arg)
+{
+    char buf[16];
+    int n;
+    while ((n = thread_read(fds[0], buf, sizeof(buf) - 1)) > 0) {
+        buf[n] = 0;
+        printf("reader: %s\n", buf);
+    }
+    printf("reader: eof\n");
+}
+
+void writer(void *arg)
+{
+    int i;
+    char c;
+    for (i = 0; i < 3; i++) {
+        printf("writer: %d\n", i);
+        c = 'a' + i;
+        write(fds[1], &c, 1);
+        thread_yield();
+    }
+    close(fds[1]);
+    printf("writer: done\n");
+}
+
+void counter(void *arg)
+{
+    int i;
+    for (i = 0; i < 5; i++) {
+        printf("counter: %d\n", i);
+        thread_yield();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    printf("mp1-part3-0\n");
+    if (pipe(fds) < 0) {
+        fprintf(2, "pipe failed\n");
+        exit(1);
+    }
+    struct thread *t1 = thread_create(reader, NULL);
+    thread_add_runqueue(t1);
+    struct thread *t2 = thread_create(writer, NULL);
+    thread_add_runqueue(t2);
+    struct thread *t3 = thread_create(counter, NULL);
+    thread_add_runqueue(t3);
+    thread_start_threading();
+    printf("\nexited\n");
+    exit(0);
+}
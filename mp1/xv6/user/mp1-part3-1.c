@@ -0,0 +1,35 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/threads.h"
+
+#define NULL 0
+
+static int key;
+
+void f(void *arg)
+{
+    int id = (int)(uint64)arg;
+    int i;
+    char *name = malloc(16);
+    name[0] = 'a' + id - 1;
+    name[1] = 0;
+    thread_setspecific(key, name);
+    for (i = 0; i < 3; i++) {
+        printf("thread %d: %s\n", id, (char *)thread_getspecific(key));
+        thread_yield();
+    }
+    free(name);
+}
+
+int main(int argc, char **argv)
+{
+    printf("mp1-part3-1\n");
+    key = thread_key_create();
+    struct thread *t1 = thread_create(f, (void *)1);
+    thread_add_runqueue(t1);
+    struct thread *t2 = thread_create(f, (void *)2);
+    thread_add_runqueue(t2);
+    thread_start_threading();
+    printf("\nexited\n");
+    exit(0);
+}
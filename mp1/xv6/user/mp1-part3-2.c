@@ -0,0 +1,42 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/threads.h"
+
+#define NULL 0
+
+static int progress[3];
+
+int counter(struct coroutine *co)
+{
+    int id = (int)(uint64)co->arg;
+    co_begin(co);
+    while (progress[id] < 2) {
+        printf("co %d: %d\n", id, progress[id]++);
+        co_yield(co);
+    }
+    co_end(co);
+}
+
+void f(void *arg)
+{
+    int id = (int)(uint64)arg;
+    int i;
+    for (i = 0; i < 3; i++) {
+        printf("thread %d: %d\n", id, i);
+        thread_yield();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    printf("mp1-part3-2\n");
+    struct thread *t1 = thread_create(f, (void *)1);
+    thread_add_runqueue(t1);
+    co_add_runqueue(co_create(counter, (void *)1));
+    co_add_runqueue(co_create(counter, (void *)2));
+    struct thread *t2 = thread_create(f, (void *)2);
+    thread_add_runqueue(t2);
+    thread_start_threading();
+    printf("\nexited\n");
+    exit(0);
+}
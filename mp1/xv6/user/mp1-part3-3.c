@@ -0,0 +1,28 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/threads.h"
+
+#define NULL 0
+
+void f(void *arg)
+{
+    struct thread *t = get_current_thread();
+    int ticks = (int)(uint64)arg;
+    printf("thread %d: sleep %d\n", t->ID, ticks);
+    thread_sleep(ticks);
+    printf("thread %d: awake\n", t->ID);
+}
+
+int main(int argc, char **argv)
+{
+    printf("mp1-part3-3\n");
+    struct thread *t1 = thread_create(f, (void *)4);
+    thread_add_runqueue(t1);
+    struct thread *t2 = thread_create(f, (void *)1);
+    thread_add_runqueue(t2);
+    struct thread *t3 = thread_create(f, (void *)2);
+    thread_add_runqueue(t3);
+    thread_start_threading();
+    printf("\nexited\n");
+    exit(0);
+}
@@ -0,0 +1,55 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/threads.h"
+
+#define NULL 0
+
+static int progress;
+
+int child(struct coroutine *co)
+{
+    co_begin(co);
+    while (progress < 2) {
+        printf("co child: %d\n", progress++);
+        co_yield(co);
+    }
+    co_end(co);
+}
+
+int late(struct coroutine *co)
+{
+    co_begin(co);
+    printf("co late\n");
+    co_end(co);
+}
+
+// the only coroutine queues another and finishes in the same step
+int spawner(struct coroutine *co)
+{
+    co_begin(co);
+    printf("co spawner\n");
+    co_add_runqueue(co_create(child, NULL));
+    co_end(co);
+}
+
+void f(void *arg)
+{
+    int i;
+    for (i = 0; i < 4; i++) {
+        printf("thread: %d\n", i);
+        if (i == 2)
+            co_add_runqueue(co_create(late, NULL));
+        thread_yield();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    printf("mp1-part3-4\n");
+    struct thread *t = thread_create(f, NULL);
+    thread_add_runqueue(t);
+    co_add_runqueue(co_create(spawner, NULL));
+    thread_start_threading();
+    printf("\nexited\n");
+    exit(0);
+}
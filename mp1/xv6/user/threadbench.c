@@ -0,0 +1,220 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/threads.h"
+
+#define NULL 0
+#define ITERS 100
+
+// Microbenchmarks for the thread package. Times are read with rdtime,
+// in cycles of the CLINT timer (10MHz under qemu). Every result is one
+// line that gradelib.bench_results() can collect:
+//   bench: <name> threads=<n> ops=<count> avg=<cycles> min=<cycles> max=<cycles>
+
+struct acc {
+    uint64 total;
+    uint64 min;
+    uint64 max;
+    int n;
+};
+
+static int counts[] = { 2, 10, 100, 1000 };
+static struct acc a_switch, a_rtt, a_create, a_exit, a_kill, a_suspend, a_resume, a_scan;
+static uint64 mark;
+static int done;
+static struct thread *target_thread;
+static struct thread **all;
+static int nthreads;
+
+static inline uint64 rdtime(void)
+{
+    uint64 t;
+    asm volatile("rdtime %0" : "=r"(t));
+    return t;
+}
+
+static void acc_reset(struct acc *a)
+{
+    a->total = 0;
+    a->min = ~0UL;
+    a->max = 0;
+    a->n = 0;
+}
+
+static void acc_add(struct acc *a, uint64 v)
+{
+    a->total += v;
+    if (v < a->min)
+        a->min = v;
+    if (v > a->max)
+        a->max = v;
+    a->n++;
+}
+
+static void report(char *name, struct acc *a)
+{
+    if (a->n == 0)
+        return;
+    printf("bench: %s threads=%d ops=%d avg=%d min=%d max=%d\n",
+           name, nthreads, a->n, (int)(a->total / a->n), (int)a->min, (int)a->max);
+}
+
+// yield: one-way switch (yield call to the next thread running) and
+// round trip (yield call until the same thread runs again).
+void yielder(void *arg)
+{
+    uint64 t0, now;
+    int i;
+    for (i = 0; i < ITERS; i++) {
+        t0 = rdtime();
+        mark = t0;
+        thread_yield();
+        now = rdtime();
+        acc_add(&a_rtt, now - t0);
+        acc_add(&a_switch, now - mark);
+    }
+}
+
+// create+exit: thread_create+thread_add_runqueue in main, then the time
+// from one empty thread starting to the next one starting, i.e. exit+dispatch.
+void empty(void *arg)
+{
+    uint64 now = rdtime();
+    if (mark)
+        acc_add(&a_exit, now - mark);
+    mark = rdtime();
+}
+
+// thread_kill to handler entry. The target sits at the end of the run
+// queue, so the latency includes a pass over every other thread.
+void on_kill(int signo)
+{
+    acc_add(&a_kill, rdtime() - mark);
+}
+
+void killer(void *arg)
+{
+    int i;
+    thread_yield(); // let the target register its handler
+    for (i = 0; i < ITERS; i++) {
+        mark = rdtime();
+        thread_kill(target_thread, 0);
+        thread_yield();
+    }
+    done = 1;
+}
+
+void target(void *arg)
+{
+    thread_register_handler(0, on_kill);
+    while (!done)
+        thread_yield();
+}
+
+void idler(void *arg)
+{
+    while (!done)
+        thread_yield();
+}
+
+// suspend/resume of every other thread, and a yield that has to skip
+// all of them while they are suspended.
+void controller(void *arg)
+{
+    uint64 t0;
+    int i, j;
+    thread_yield(); // let everyone start
+    for (i = 0; i < ITERS / 10; i++) {
+        for (j = 1; j < nthreads; j++) {
+            t0 = rdtime();
+            thread_suspend(all[j]);
+            acc_add(&a_suspend, rdtime() - t0);
+        }
+        t0 = rdtime();
+        thread_yield();
+        acc_add(&a_scan, rdtime() - t0);
+        for (j = 1; j < nthreads; j++) {
+            t0 = rdtime();
+            thread_resume(all[j]);
+            acc_add(&a_resume, rdtime() - t0);
+        }
+    }
+    done = 1;
+}
+
+static void bench_yield(void)
+{
+    int i;
+    acc_reset(&a_switch);
+    acc_reset(&a_rtt);
+    for (i = 0; i < nthreads; i++)
+        thread_add_runqueue(thread_create(yielder, NULL));
+    thread_start_threading();
+    report("yield", &a_switch);
+    report("yield_rtt", &a_rtt);
+}
+
+static void bench_create_exit(void)
+{
+    uint64 t0;
+    int i;
+    acc_reset(&a_create);
+    acc_reset(&a_exit);
+    mark = 0;
+    for (i = 0; i < nthreads; i++) {
+        t0 = rdtime();
+        thread_add_runqueue(thread_create(empty, NULL));
+        acc_add(&a_create, rdtime() - t0);
+    }
+    thread_start_threading();
+    report("create", &a_create);
+    report("exit", &a_exit);
+}
+
+static void bench_kill(void)
+{
+    int i;
+    acc_reset(&a_kill);
+    done = 0;
+    thread_add_runqueue(thread_create(killer, NULL));
+    for (i = 2; i < nthreads; i++)
+        thread_add_runqueue(thread_create(idler, NULL));
+    target_thread = thread_create(target, NULL);
+    thread_add_runqueue(target_thread);
+    thread_start_threading();
+    report("kill", &a_kill);
+}
+
+static void bench_suspend(void)
+{
+    int i;
+    acc_reset(&a_suspend);
+    acc_reset(&a_resume);
+    acc_reset(&a_scan);
+    done = 0;
+    all = malloc(sizeof(struct thread *) * nthreads);
+    all[0] = thread_create(controller, NULL);
+    thread_add_runqueue(all[0]);
+    for (i = 1; i < nthreads; i++) {
+        all[i] = thread_create(idler, NULL);
+        thread_add_runqueue(all[i]);
+    }
+    thread_start_threading();
+    free(all);
+    report("suspend", &a_suspend);
+    report("resume", &a_resume);
+    report("yield_suspended", &a_scan);
+}
+
+int main(int argc, char **argv)
+{
+    int i;
+    printf("threadbench\n");
+    for (i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+        nthreads = counts[i];
+        bench_yield();
+        bench_create_exit();
+        bench_kill();
+        bench_suspend();
+    }
+    exit(0);
+}
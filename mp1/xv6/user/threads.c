@@ -3,6 +3,7 @@
 #include "user/threads.h"
 #include "user/user.h"
 #define NULL 0
+#define POLL_MAX 16 // NOFILE: at most this many distinct fds can be open
 
 
 static struct thread* current_thread = NULL;
@@ -12,6 +13,13 @@ static int id = 1;
 static jmp_buf env_st; 
 static jmp_buf env_tmp;  
 static jmp_buf handler_env_tmp;  // Add this global variable
+static int io_waiters = 0; // number of threads parked in thread_wait_fd()
+static struct thread *sleep_queue = NULL; // off the run queue, sorted by wake_tick
+static int tls_keys = 0; // number of keys handed out by thread_key_create()
+// coroutines run one step per turn of a single driver thread in the run queue
+static struct coroutine *co_head = NULL;
+static struct coroutine *co_tail = NULL;
+static struct thread *co_driver = NULL;
 
 struct thread *get_current_thread() {
     return current_thread;
@@ -38,9 +46,22 @@ struct thread *thread_create(void (*f)(void *), void *arg){
     t->signo = -1;
     t->handler_buf_set = 0;
 
+    // Part 3
+    t->wait_fd = -1;
+    t->sleep_next = NULL;
+    memset(t->tls, 0, sizeof(t->tls));
+    t->arena = arena_create(THREAD_ARENA_SIZE);
+
     return t;
 }
 
+// point tp and the small-object allocator at t, or at nothing for main
+static void __switch_tls(struct thread *t) {
+    void **tls = t ? t->tls : NULL;
+    asm volatile("mv tp, %0" : : "r"(tls));
+    malloc_arena = t ? t->arena : NULL;
+}
+
 
 void thread_add_runqueue(struct thread *t) {
     if (current_thread == NULL) {
@@ -61,6 +82,50 @@ void thread_add_runqueue(struct thread *t) {
     }
 }
 
+// a pending signal also wakes a thread parked on an fd
+static int __thread_runnable(struct thread *t) {
+    return !t->suspended && (t->wait_fd < 0 || t->signo != -1);
+}
+
+// poll every fd a thread is parked on and unpark the threads whose fd
+// is ready. timeout is handed to poll(): 0 checks, -1 blocks the process.
+static void __poll_io(int timeout) {
+    struct pollfd fds[POLL_MAX];
+    struct thread *t = current_thread;
+    int nfds = 0, i;
+
+    do {
+        if (t->wait_fd >= 0) {
+            for (i = 0; i < nfds && fds[i].fd != t->wait_fd; i++)
+                ;
+            if (i == nfds && nfds < POLL_MAX) {
+                fds[nfds].fd = t->wait_fd;
+                fds[nfds].events = 0;
+                nfds++;
+            }
+            if (i < nfds)
+                fds[i].events |= t->wait_events;
+        }
+        t = t->next;
+    } while (t != current_thread);
+
+    if (poll(fds, nfds, timeout) <= 0)
+        return;
+
+    do {
+        if (t->wait_fd >= 0) {
+            for (i = 0; i < nfds && fds[i].fd != t->wait_fd; i++)
+                ;
+            if (i < nfds && (fds[i].revents & (t->wait_events | POLLHUP | POLLNVAL))) {
+                t->wait_revents = fds[i].revents & (t->wait_events | POLLHUP | POLLNVAL);
+                t->wait_fd = -1;
+                io_waiters--;
+            }
+        }
+        t = t->next;
+    } while (t != current_thread);
+}
+
 void thread_yield(void) {
     if(current_thread->signo != -1) {
         int pds = setjmp(current_thread->handler_env);
@@ -105,6 +170,7 @@ void sig_func() {
 }
 
 void dispatch(void) {
+    __switch_tls(current_thread);
     int sig_no = current_thread->signo;
     if(sig_no != -1) {
         if(current_thread->sig_handler[sig_no] == NULL_FUNC) {
@@ -131,15 +197,94 @@ void dispatch(void) {
     }
 }
 
+// put t back at the end of the run queue, which may be empty
+static void __ring_insert(struct thread *t) {
+    if (current_thread == NULL) {
+        current_thread = t;
+        t->next = t;
+        t->previous = t;
+    } else {
+        t->next = current_thread;
+        t->previous = current_thread->previous;
+        current_thread->previous->next = t;
+        current_thread->previous = t;
+    }
+}
+
+// threads due at the same tick wake in the order they went to sleep
+static void __sleep_insert(struct thread *t) {
+    struct thread **pp = &sleep_queue;
+    while (*pp != NULL && (*pp)->wake_tick <= t->wake_tick)
+        pp = &(*pp)->sleep_next;
+    t->sleep_next = *pp;
+    *pp = t;
+}
+
+static void __wake_sleepers(void) {
+    int now = uptime();
+    while (sleep_queue != NULL && sleep_queue->wake_tick <= now) {
+        struct thread *t = sleep_queue;
+        sleep_queue = t->sleep_next;
+        t->sleep_next = NULL;
+        __ring_insert(t);
+    }
+}
+
+// nothing can run: block the process until a parked fd is ready or the
+// earliest sleeper is due. only called with io_waiters or sleepers.
+static void __idle(void) {
+    int timeout = -1;
+    if (sleep_queue != NULL) {
+        timeout = sleep_queue->wake_tick - uptime();
+        if (timeout < 0)
+            timeout = 0;
+    }
+    if (io_waiters > 0)
+        __poll_io(timeout);
+    else if (timeout > 0)
+        sleep(timeout);
+    if (sleep_queue != NULL)
+        __wake_sleepers();
+}
+
+// current_thread has left the run queue: run the first runnable thread
+// from start on. start is NULL when every remaining thread is asleep.
+static void __run_next(struct thread *start) {
+    current_thread = start;
+    while (current_thread == NULL)
+        __idle();
+    start = current_thread;
+    while (!__thread_runnable(current_thread)) {
+        current_thread = current_thread->next;
+        if (current_thread == start) {
+            // All threads are suspended
+            if (io_waiters == 0 && sleep_queue == NULL)
+                break;
+            __idle();
+        }
+    }
+    dispatch();
+}
+
 //schedule will follow the rule of FIFO
 void schedule(void){
     struct thread *head;
     head = current_thread;
+    if(sleep_queue != NULL)
+        __wake_sleepers();
+    if(io_waiters > 0)
+        __poll_io(0);
     current_thread = current_thread->next;
-    
+
     //Part 2: TO DO
     // skip yg suspended disini, trus incase infinite loop bikin condition baru
-    while(current_thread->suspended && current_thread != head){
+    while(!__thread_runnable(current_thread)){
+        if(current_thread == head){
+            // everyone is suspended, parked or asleep: wait for an fd or a timer
+            if(io_waiters == 0 && sleep_queue == NULL)
+                break;
+            __idle();
+        }
         current_thread = current_thread->next;
     }
 
@@ -150,6 +295,11 @@ void schedule(void){
 }
 
 void thread_exit(void){
+    if (current_thread->wait_fd >= 0) {
+        // killed while parked on an fd
+        current_thread->wait_fd = -1;
+        io_waiters--;
+    }
     if (current_thread->next != current_thread) {
         //TO DO
         // Remove current thread from the runqueue
@@ -160,35 +310,32 @@ void thread_exit(void){
         struct thread *next_thread = current_thread->next;
         
         // Free the thread's memory
+        arena_destroy(current_thread->arena);
         void *stack = current_thread->stack;
         free(stack);
         free(current_thread);
         
-        // Update current_thread to point to the next thread
-        current_thread = next_thread;
-        
-        // Skip any suspended threads
-        struct thread *start = current_thread;
-        while (current_thread->suspended) {
-            current_thread = current_thread->next;
-            if (current_thread == start) {
-                // All threads are suspended
-                break;
-            }
-        }
-        
-        // Dispatch the next thread
-        dispatch();
+        // Skip any suspended or parked threads, then dispatch
+        __run_next(next_thread);
+    } else if (sleep_queue != NULL) {
+        // Last runnable thread is exiting, wait for a sleeper
+        arena_destroy(current_thread->arena);
+        free(current_thread->stack);
+        free(current_thread);
+        __run_next(NULL);
     } else {
         // Last thread is exiting
+        arena_destroy(current_thread->arena);
         free(current_thread->stack);
         free(current_thread);
         current_thread = NULL;
+        __switch_tls(NULL);
         longjmp(env_st, 1);
     }
 }
 
 void thread_start_threading(void){
+    __switch_tls(NULL);
     //TO DO
     // save context, lgsg run first thread pake dispatch
     if(setjmp(env_st) == 0){
@@ -223,4 +370,155 @@ void thread_suspend(struct thread *t) {
 void thread_resume(struct thread *t) {
     //TO DO
     t->suspended = 0; // tinggal ganti status yey
-}
\ No newline at end of file
+}
+
+//PART 3
+// park the current thread until fd is ready for events, letting the
+// other threads run meanwhile. returns the ready events (POLLHUP/POLLNVAL
+// included), or -1 if a signal arrived first.
+int thread_wait_fd(int fd, int events) {
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = events;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, 0) != 0) // already ready (or a bad fd): no need to park
+        return pfd.revents ? pfd.revents : -1;
+
+    current_thread->wait_fd = fd;
+    current_thread->wait_events = events;
+    current_thread->wait_revents = 0;
+    io_waiters++;
+    thread_yield();
+
+    if (current_thread->wait_fd >= 0) {
+        current_thread->wait_fd = -1;
+        io_waiters--;
+        return -1;
+    }
+    return current_thread->wait_revents;
+}
+
+// read() that only parks the calling thread instead of the whole process
+int thread_read(int fd, void *buf, int n) {
+    if (thread_wait_fd(fd, POLLIN) < 0)
+        return -1;
+    return read(fd, buf, n);
+}
+
+int thread_write(int fd, const void *buf, int n) {
+    if (thread_wait_fd(fd, POLLOUT) < 0)
+        return -1;
+    return write(fd, buf, n);
+}
+
+// take the current thread off the run queue for at least ticks ticks.
+// when nothing else can run the process sleeps in the kernel instead.
+void thread_sleep(int ticks) {
+    struct thread *t = current_thread;
+    if (ticks <= 0) {
+        thread_yield();
+        return;
+    }
+    t->wake_tick = uptime() + ticks;
+
+    // inside a signal handler env belongs to the interrupted code, so the
+    // handler sleeps in handler_env; dispatch() resumes it there while
+    // signo is set, as it does after thread_yield().
+    int in_handler = t->signo != -1;
+    if (setjmp(in_handler ? t->handler_env : t->env) == 0) {
+        if (in_handler)
+            t->handler_buf_set = 1;
+        else
+            t->buf_set = 1;
+        struct thread *next = t->next == t ? NULL : t->next;
+        t->previous->next = t->next;
+        t->next->previous = t->previous;
+        __sleep_insert(t);
+        __run_next(next);
+    }
+    if (current_thread->signo != -1)
+        current_thread->handler_buf_set = 0;
+    else
+        current_thread->buf_set = 0;
+}
+
+// thread-local storage: each thread has THREAD_KEYS_MAX slots, found
+// through tp so a lookup never touches the run queue.
+static void **__tls(void) {
+    void **tls;
+    asm volatile("mv %0, tp" : "=r"(tls));
+    return tls;
+}
+
+// returns a key valid in every thread, or -1 if all are taken
+int thread_key_create(void) {
+    if (tls_keys >= THREAD_KEYS_MAX)
+        return -1;
+    return tls_keys++;
+}
+
+void thread_setspecific(int key, void *value) {
+    void **tls = __tls();
+    if (tls != NULL && key >= 0 && key < tls_keys)
+        tls[key] = value;
+}
+
+void *thread_getspecific(int key) {
+    void **tls = __tls();
+    if (tls == NULL || key < 0 || key >= tls_keys)
+        return NULL;
+    return tls[key];
+}
+
+// coroutines
+struct coroutine *co_create(int (*fn)(struct coroutine *), void *arg) {
+    struct coroutine *co = (struct coroutine*) malloc(sizeof(struct coroutine));
+    co->fn = fn;
+    co->arg = arg;
+    co->line = 0;
+    co->next = NULL;
+    return co;
+}
+
+// each time the driver is dispatched, every coroutine runs to its next
+// co_yield/co_await; the driver then yields like any other thread.
+static void __co_run(void *arg) {
+    struct coroutine *co, *prev, *next;
+    for (;;) {
+        prev = NULL;
+        for (co = co_head; co != NULL; co = next) {
+            int done = co->fn(co) == CO_DONE;
+            // read after the step, which may have queued more behind co
+            next = co->next;
+            if (done) {
+                if (prev == NULL)
+                    co_head = next;
+                else
+                    prev->next = next;
+                if (co_tail == co)
+                    co_tail = prev;
+                free(co);
+            } else {
+                prev = co;
+            }
+        }
+        if (co_head == NULL)
+            break;
+        thread_yield();
+    }
+    co_driver = NULL;
+}
+
+void co_add_runqueue(struct coroutine *co) {
+    co->next = NULL;
+    if (co_tail == NULL)
+        co_head = co;
+    else
+        co_tail->next = co;
+    co_tail = co;
+
+    if (co_driver == NULL) {
+        co_driver = thread_create(__co_run, NULL);
+        thread_add_runqueue(co_driver);
+    }
+}
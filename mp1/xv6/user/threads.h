@@ -3,8 +3,13 @@
 #define NULL_FUNC ((void (*)(int))-1)
 // TODO: necessary includes, if any
 #include "user/setjmp.h"
+#include "kernel/poll.h"
 // TODO: necessary defines, if any
 #define THREADS_MAX 100
+#define THREAD_KEYS_MAX 8 // thread-local slots per thread
+#define THREAD_ARENA_SIZE 1024 // bytes of per-thread small-object heap
+
+struct arena;
 
 struct thread {
     void (*fp)(void *arg);
@@ -23,8 +28,38 @@ struct thread {
     int signo; // -1: no signal comes, 0: receive a signal signo = 0, 1: receive a signal signo = 1
     jmp_buf handler_env; // for signal handler function
     int handler_buf_set; //1: indicate jmp_buf (handler_env) has been set, 0: indicate jmp_buf (handler_env) not set
+
+    // part 3
+    int wait_fd; // -1: not waiting, otherwise the fd this thread is parked on
+    short wait_events; // POLLIN/POLLOUT the thread is waiting for
+    short wait_revents; // what poll() reported when the thread was unparked
+    int wake_tick; // uptime() at which a sleeping thread is due
+    struct thread *sleep_next; // next in the sleep queue
+
+    // thread-local storage, tp points at tls while the thread runs
+    void *tls[THREAD_KEYS_MAX];
+    struct arena *arena; // small mallocs made by this thread come from here
+};
+
+// stackless coroutines: a resumable function plus its resume point.
+// Locals do not survive co_yield/co_await, keep state in arg.
+struct coroutine {
+    int (*fn)(struct coroutine *co); // returns CO_YIELDED or CO_DONE
+    void *arg;
+    int line; // where fn resumes, 0: from the top
+    struct coroutine *next;
 };
 
+#define CO_YIELDED 0
+#define CO_DONE 1
+
+// fn body must be wrapped in co_begin/co_end; at most one co_yield or
+// co_await per source line.
+#define co_begin(co) switch ((co)->line) { case 0:
+#define co_yield(co) do { (co)->line = __LINE__; return CO_YIELDED; case __LINE__:; } while (0)
+#define co_await(co, cond) do { (co)->line = __LINE__; case __LINE__: if (!(cond)) return CO_YIELDED; } while (0)
+#define co_end(co) } (co)->line = 0; return CO_DONE
+
 struct thread *thread_create(void (*f)(void *), void *arg);
 void thread_add_runqueue(struct thread *t);
 void thread_yield(void);
@@ -38,4 +73,16 @@ void thread_register_handler(int signo, void (*f)(int));
 void thread_kill(struct thread *t, int signo);
 void thread_resume(struct thread *t);
 void thread_suspend(struct thread *t);
+// part 3
+int thread_wait_fd(int fd, int events);
+int thread_read(int fd, void *buf, int n);
+int thread_write(int fd, const void *buf, int n);
+void thread_sleep(int ticks);
+// thread-local storage
+int thread_key_create(void);
+void thread_setspecific(int key, void *value);
+void *thread_getspecific(int key);
+// coroutines
+struct coroutine *co_create(int (*fn)(struct coroutine *), void *arg);
+void co_add_runqueue(struct coroutine *co);
 #endif // THREADS_H_
@@ -1,5 +1,6 @@
 struct stat;
 struct rtcdate;
+struct pollfd;
 
 // system calls
 int fork(void);
@@ -23,6 +24,8 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
+int poll(struct pollfd*, int, int);
+int fcntl(int, int, int);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -40,3 +43,9 @@ void free(void*);
 int atoi(const char*);
 int memcmp(const void *, const void *, uint);
 void *memcpy(void *, const void *, uint);
+
+// umalloc.c
+struct arena;
+extern struct arena *malloc_arena;
+struct arena *arena_create(uint);
+void arena_destroy(struct arena*);
@@ -110,5 +110,98 @@ thread#2 misses a deadline at 15 in dispatch"""
     if not re.findall(expected, r.qemu.output, re.M):
         raise AssertionError('Output does not match expected output')
 
+@test(2, "task6")
+def test_uthread():
+    r.run_qemu(shell_script([
+        'rttask6 DM'
+    ]), make_args = ["SCHEDPOLICY=THREAD_SCHEDULER_DM"])
+    expected = """dispatch thread#2 at 0: allocated_time=1
+dispatch thread#3 at 1: allocated_time=1
+dispatch thread#1 at 2: allocated_time=3
+thread#1 finish one cycle at 5: 1 cycles left
+dispatch thread#3 at 5: allocated_time=2
+thread#3 finish one cycle at 7: 1 cycles left
+dispatch thread#2 at 7: allocated_time=3
+dispatch thread#3 at 10: allocated_time=1
+dispatch thread#1 at 11: allocated_time=3
+thread#1 finish one cycle at 14: 0 cycles left
+dispatch thread#3 at 14: allocated_time=2
+thread#3 finish one cycle at 16: 0 cycles left
+thread#2 misses a deadline at 15"""
+    if not re.findall(expected, r.qemu.output, re.M):
+        raise AssertionError('Output does not match expected output')
+
+@test(2, "task9")
+def test_uthread():
+    r.run_qemu(shell_script([
+        'rttask9 DM'
+    ]), make_args = ["SCHEDPOLICY=THREAD_SCHEDULER_DM"])
+    expected = """dispatch thread#1 at 0: allocated_time=1
+thread#3 blocks on a mutex held by thread#1 at 1
+dispatch thread#1 at 1: allocated_time=2
+dispatch thread#3 at 3: allocated_time=1
+dispatch thread#3 at 4: allocated_time=1
+thread#3 finish one cycle at 5: 1 cycles left
+dispatch thread#2 at 5: allocated_time=4
+thread#2 finish one cycle at 9: 0 cycles left"""
+    if not re.findall(expected, r.qemu.output, re.M):
+        raise AssertionError('Output does not match expected output')
+
+@test(2, "task9 ceiling")
+def test_uthread():
+    r.run_qemu(shell_script([
+        'rttask9 DM ceiling'
+    ]), make_args = ["SCHEDPOLICY=THREAD_SCHEDULER_DM"])
+    expected = """dispatch thread#1 at 0: allocated_time=3
+dispatch thread#3 at 3: allocated_time=1
+dispatch thread#3 at 4: allocated_time=1
+thread#3 finish one cycle at 5: 1 cycles left
+dispatch thread#2 at 5: allocated_time=4
+thread#2 finish one cycle at 9: 0 cycles left"""
+    if not re.findall(expected, r.qemu.output, re.M):
+        raise AssertionError('Output does not match expected output')
+
+@test(2, "task10")
+def test_uthread():
+    r.run_qemu(shell_script([
+        'rttask10 DM'
+    ]), make_args = ["SCHEDPOLICY=THREAD_SCHEDULER_DM"])
+    expected = """dispatch thread#2 at 7: allocated_time=1
+thread#2 finish one cycle at 8: 0 cycles left
+dispatch thread#3 at 8: allocated_time=2
+thread#3 finish at 10"""
+    if not re.findall(expected, r.qemu.output, re.M):
+        raise AssertionError('Output does not match expected output')
+
+@test(2, "task10 sporadic")
+def test_uthread():
+    r.run_qemu(shell_script([
+        'rttask10 DM sporadic'
+    ]), make_args = ["SCHEDPOLICY=THREAD_SCHEDULER_DM"])
+    expected = """dispatch thread#2 at 2: allocated_time=1
+dispatch thread#3 at 3: allocated_time=2
+thread#3 finish at 5
+dispatch thread#1 at 5: allocated_time=2
+thread#1 finish one cycle at 7: 2 cycles left
+dispatch thread#2 at 7: allocated_time=3
+thread#2 finish one cycle at 10: 0 cycles left"""
+    if not re.findall(expected, r.qemu.output, re.M):
+        raise AssertionError('Output does not match expected output')
+
+@test(2, "task10 deferrable")
+def test_uthread():
+    r.run_qemu(shell_script([
+        'rttask10 DM deferrable'
+    ]), make_args = ["SCHEDPOLICY=THREAD_SCHEDULER_DM"])
+    expected = """dispatch thread#2 at 2: allocated_time=1
+dispatch thread#3 at 3: allocated_time=2
+thread#3 finish at 5
+dispatch thread#1 at 5: allocated_time=2
+thread#1 finish one cycle at 7: 2 cycles left
+dispatch thread#2 at 7: allocated_time=3
+thread#2 finish one cycle at 10: 0 cycles left"""
+    if not re.findall(expected, r.qemu.output, re.M):
+        raise AssertionError('Output does not match expected output')
+
 run_tests()
 os.system("make -s --no-print-directory clean")
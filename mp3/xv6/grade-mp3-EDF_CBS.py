@@ -100,5 +100,54 @@ thread#1 finish one cycle at 35: 0 cycles left"""
     if not re.findall(expected, r.qemu.output, re.M):
         raise AssertionError('Output does not match expected output')
 
+@test(2, "task6")
+def test_uthread():
+    r.run_qemu(shell_script([
+        'rttask6 EDF_CBS'
+    ]), make_args = ["SCHEDPOLICY=THREAD_SCHEDULER_EDF_CBS"])
+    expected = """dispatch thread#1 at 0: allocated_time=15
+thread#1 finish one cycle at 15: 1 cycles left
+dispatch thread#2 at 15: allocated_time=10
+thread#2 finish one cycle at 25: 1 cycles left
+dispatch thread#1 at 25: allocated_time=15
+thread#1 finish one cycle at 40: 0 cycles left
+dispatch thread#2 at 40: allocated_time=10
+thread#2 finish one cycle at 50: 0 cycles left"""
+    if not re.findall(expected, r.qemu.output, re.M):
+        raise AssertionError('Output does not match expected output')
+
+@test(2, "task11 EDF_VD")
+def test_uthread():
+    r.run_qemu(shell_script([
+        'rttask11 EDF_VD'
+    ]), make_args = ["SCHEDPOLICY=THREAD_SCHEDULER_EDF_VD"])
+    expected = """dispatch thread#1 at 0: allocated_time=1
+thread#1 finish one cycle at 1: 1 cycles left
+dispatch thread#3 at 1: allocated_time=1
+thread#3 finish one cycle at 2: 3 cycles left
+dispatch thread#2 at 2: allocated_time=3
+thread#2 finish one cycle at 5: 2 cycles left"""
+    if not re.findall(expected, r.qemu.output, re.M):
+        raise AssertionError('Output does not match expected output')
+
+@test(2, "task11 EDF_VD overrun")
+def test_uthread():
+    r.run_qemu(shell_script([
+        'rttask11 EDF_VD overrun'
+    ]), make_args = ["SCHEDPOLICY=THREAD_SCHEDULER_EDF_VD"])
+    expected = """dispatch thread#1 at 0: allocated_time=1
+thread#2 drops a job at 1: 2 cycles left
+thread#3 drops a job at 1: 3 cycles left
+dispatch thread#1 at 1: allocated_time=3
+thread#1 finish one cycle at 4: 1 cycles left"""
+    if not re.findall(expected, r.qemu.output, re.M):
+        raise AssertionError('Output does not match expected output')
+    expected = """dispatch thread#1 at 10: allocated_time=1
+thread#3 drops a job at 11: 1 cycles left
+dispatch thread#1 at 11: allocated_time=3
+thread#1 finish one cycle at 14: 0 cycles left"""
+    if not re.findall(expected, r.qemu.output, re.M):
+        raise AssertionError('Output does not match expected output')
+
 run_tests()
 os.system("make -s --no-print-directory clean")
@@ -8,6 +8,7 @@ struct spinlock;
 struct sleeplock;
 struct stat;
 struct superblock;
+struct trapframe;
 
 // bio.c
 void            binit(void);
@@ -102,6 +103,8 @@ void            userinit(void);
 int             wait(uint64);
 void            wakeup(void*);
 void            yield(void);
+int             sched_deadline(int, int, int);
+void            dl_tick(struct proc*);
 int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
 void            procdump(void);
@@ -140,12 +143,20 @@ int             fetchstr(uint64, char*, int);
 int             fetchaddr(uint64, uint64*);
 void            syscall();
 
+// thrd.c
+struct trapframe* thrdstop_context(struct proc*, int);
+void            thrdstop_freeall(struct proc*);
+void            thrdtimer_init(struct proc*);
+void            thrdtimer_arm(struct proc*);
+int             thrdtimer_deliver(struct proc*);
+
 // trap.c
 extern uint     ticks;
 void            trapinit(void);
 void            trapinithart(void);
 extern struct spinlock tickslock;
 void            usertrapret(void);
+void            timer_oneshot(uint64);
 
 // uart.c
 void            uartinit(void);
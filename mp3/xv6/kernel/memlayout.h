@@ -29,6 +29,17 @@
 #define CLINT 0x2000000L
 #define CLINT_MTIMECMP(hartid) (CLINT + 0x4000 + 8*(hartid))
 #define CLINT_MTIME (CLINT + 0xBFF8) // cycles since boot.
+#define CLINT_HZ 10000000L // mtime frequency in qemu.
+
+// timer_scratch[hart][] slots read by timervec in kernelvec.S,
+// after a four-register save area.
+#define TIMER_MTIMECMP 4 // address of CLINT_MTIMECMP(hart).
+#define TIMER_INTERVAL 5 // cycles between ticks.
+#define TIMER_NEXT     6 // mtime of the next tick.
+#define TIMER_ONESHOT  7 // mtime of an extra interrupt, 0 if none.
+#define TIMER_PENDING  8 // ticks not yet taken by devintr().
+#define TIMER_MTIME    9 // address of CLINT_MTIME.
+#define TIMER_SCRATCH  10
 
 // qemu puts platform-level interrupt controller (PLIC) here.
 #define PLIC 0x0c000000L
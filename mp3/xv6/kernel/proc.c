@@ -15,8 +15,15 @@ struct proc *initproc;
 int nextpid = 1;
 struct spinlock pid_lock;
 
+// bandwidth reserved by the deadline class, in 1/DL_BW_ONE of a hart.
+#define DL_BW_ONE (1 << 20)
+struct spinlock dl_lock;
+uint dl_total;
+int dl_nproc;
+
 extern void forkret(void);
 static void wakeup1(struct proc *chan);
+static void setrunnable(struct proc *p);
 static void freeproc(struct proc *p);
 
 extern char trampoline[]; // trampoline.S
@@ -43,8 +50,12 @@ void
 procinit(void)
 {
   struct proc *p;
+  struct cpu *c;
   
   initlock(&pid_lock, "nextpid");
+  initlock(&dl_lock, "deadline");
+  for(c = cpus; c < &cpus[NCPU]; c++)
+    initlock(&c->rq_lock, "runq");
   for(p = proc; p < &proc[NPROC]; p++) {
       initlock(&p->lock, "proc");
       p->kstack = KSTACK((int) (p - proc));
@@ -113,18 +124,24 @@ allocproc(void)
 
 found:
   p->pid = allocpid();
+  p->affinity = -1;
+  p->cputime = 0;
+  p->dl_runtime = 0;
+  p->dl_throttled = 0;
+  p->dl_bw = 0;
 
   // for mp3
   p->thrdstop_ticks = 0;
   p->thrdstop_delay = -1;
+  p->thrdstop_deadline = 0;
+  p->thrdstop_start = 0;
   p->jump_flag = 0;
   p->resume_flag = -1;
   p->cancel_save_flag = -1;
-  int i;
-  for (i = 0; i < MAX_THRD_NUM; i++)
-  {
-    p->thrdstop_context_used[i] = 0;
-  }
+  p->thrdstop_pages = 0;
+  p->thrdstop_nctx = 0;
+  p->thrdstop_free = -1;
+  thrdtimer_init(p);
 
   // Allocate a trapframe page.
   if((p->trapframe = (struct trapframe *)kalloc()) == 0){
@@ -158,6 +175,15 @@ freeproc(struct proc *p)
   if(p->trapframe)
     kfree((void*)p->trapframe);
   p->trapframe = 0;
+  thrdstop_freeall(p);
+  if(p->dl_runtime > 0){
+    acquire(&dl_lock);
+    dl_total -= p->dl_bw;
+    dl_nproc--;
+    release(&dl_lock);
+    p->dl_runtime = 0;
+    p->dl_bw = 0;
+  }
   if(p->pagetable)
     proc_freepagetable(p->pagetable, p->sz);
   p->pagetable = 0;
@@ -247,7 +273,7 @@ userinit(void)
   safestrcpy(p->name, "initcode", sizeof(p->name));
   p->cwd = namei("/");
 
-  p->state = RUNNABLE;
+  setrunnable(p);
 
   release(&p->lock);
 }
@@ -293,6 +319,7 @@ fork(void)
     return -1;
   }
   np->sz = p->sz;
+  np->affinity = p->affinity;
 
   np->parent = p;
 
@@ -312,7 +339,7 @@ fork(void)
 
   pid = np->pid;
 
-  np->state = RUNNABLE;
+  setrunnable(np);
 
   release(&np->lock);
 
@@ -465,6 +492,207 @@ wait(uint64 addr)
   }
 }
 
+// Deadline class: a process that called sched_deadline() runs ahead
+// of every round-robin process, earliest absolute deadline first, for
+// at most dl_runtime ticks per dl_period (a constant bandwidth server).
+// Out of budget, it is throttled until its next period, when the
+// budget is refilled and the deadline moves one period on.
+// Caller must hold p->lock.
+static void
+dl_replenish(struct proc *p)
+{
+  uint now = ticks;
+
+  p->dl_budget = p->dl_runtime;
+  p->dl_abs += p->dl_period;
+  if((int)(p->dl_abs - now) <= 0)
+    p->dl_abs = now + p->dl_deadline;
+  p->dl_throttled = 0;
+}
+
+// CBS wakeup rule: a process that slept keeps its deadline only if
+// the budget it has left fits its bandwidth until then.
+// Caller must hold p->lock.
+static void
+dl_wake(struct proc *p)
+{
+  uint now = ticks;
+
+  if(p->dl_runtime == 0 || p->dl_throttled)
+    return;
+  if((int)(p->dl_abs - now) <= 0 ||
+     (uint64)p->dl_budget * p->dl_deadline > (uint64)(p->dl_abs - now) * p->dl_runtime){
+    p->dl_abs = now + p->dl_deadline;
+    p->dl_budget = p->dl_runtime;
+  }
+}
+
+// charge the running process the tick that just ended.
+void
+dl_tick(struct proc *p)
+{
+  acquire(&p->lock);
+  if(p->dl_runtime > 0 && --p->dl_budget <= 0)
+    p->dl_throttled = 1;
+  release(&p->lock);
+}
+
+// Join the deadline class with runtime <= deadline <= period, in ticks,
+// or leave it with runtime 0. Admission keeps the total density
+// runtime/deadline within one hart, which global EDF meets on any
+// number of harts. Returns -1 if the process would not fit.
+int
+sched_deadline(int runtime, int deadline, int period)
+{
+  struct proc *p = myproc();
+  uint bw = 0;
+
+  if(runtime < 0 || (runtime > 0 && (runtime > deadline || deadline > period)))
+    return -1;
+  if(runtime > 0)
+    bw = (uint64)runtime * DL_BW_ONE / deadline;
+
+  acquire(&p->lock);
+  acquire(&dl_lock);
+  if(dl_total - p->dl_bw + bw > DL_BW_ONE){
+    release(&dl_lock);
+    release(&p->lock);
+    return -1;
+  }
+  dl_total = dl_total - p->dl_bw + bw;
+  dl_nproc += (runtime > 0) - (p->dl_runtime > 0);
+  release(&dl_lock);
+
+  p->dl_bw = bw;
+  p->dl_runtime = runtime;
+  p->dl_deadline = deadline;
+  p->dl_period = period;
+  p->dl_budget = runtime;
+  p->dl_abs = ticks + deadline;
+  p->dl_throttled = 0;
+  release(&p->lock);
+
+  // let the scheduler place it by its new class.
+  yield();
+  return 0;
+}
+
+// the runnable deadline process with the earliest deadline that may run
+// on hart id, refilling budgets that are due on the way; returned with
+// its lock held, or 0 if there is none.
+static struct proc*
+dl_pick(int id)
+{
+  struct proc *p, *best;
+  uint abs = 0;
+
+  for(;;){
+    best = 0;
+    for(p = proc; p < &proc[NPROC]; p++){
+      acquire(&p->lock);
+      if(p->dl_runtime > 0 && p->state == RUNNABLE &&
+         (p->affinity < 0 || p->affinity == id)){
+        if(p->dl_throttled &&
+           (int)(ticks - (p->dl_abs - p->dl_deadline + p->dl_period)) >= 0)
+          dl_replenish(p);
+        if(!p->dl_throttled && (best == 0 || (int)(p->dl_abs - abs) < 0)){
+          best = p;
+          abs = p->dl_abs;
+        }
+      }
+      release(&p->lock);
+    }
+    if(best == 0)
+      return 0;
+    acquire(&best->lock);
+    if(best->state == RUNNABLE && best->dl_runtime > 0 && !best->dl_throttled)
+      return best;
+    // another hart took it meanwhile.
+    release(&best->lock);
+  }
+}
+
+// Run queues: a runnable round-robin process waits on the queue of one
+// CPU, the one it is pinned to or else the one that made it runnable.
+// A CPU runs the head of its own queue; with its queue empty it steals
+// from the longest other queue, taking the first process not pinned
+// there. Deadline-class processes are not queued, dl_pick() finds them.
+// Lock order: p->lock, then a CPU's rq_lock.
+
+// Caller must hold p->lock.
+static void
+setrunnable(struct proc *p)
+{
+  struct cpu *c;
+
+  p->state = RUNNABLE;
+  if(p->dl_runtime > 0)
+    return;
+  c = &cpus[p->affinity >= 0 ? p->affinity : cpuid()];
+  acquire(&c->rq_lock);
+  p->rq_next = 0;
+  if(c->rq_tail)
+    c->rq_tail->rq_next = p;
+  else
+    c->rq_head = p;
+  c->rq_tail = p;
+  c->rq_len++;
+  release(&c->rq_lock);
+}
+
+// unlink and return the first process on c's queue that may run on
+// hart id, or 0. On a CPU's own queue that is always the head.
+static struct proc*
+rq_take(struct cpu *c, int id)
+{
+  struct proc *p, *prev = 0;
+
+  acquire(&c->rq_lock);
+  // a queued process is not running, so its affinity stays put.
+  for(p = c->rq_head; p; prev = p, p = p->rq_next)
+    if(p->affinity < 0 || p->affinity == id)
+      break;
+  if(p){
+    if(prev)
+      prev->rq_next = p->rq_next;
+    else
+      c->rq_head = p->rq_next;
+    if(c->rq_tail == p)
+      c->rq_tail = prev;
+    c->rq_len--;
+  }
+  release(&c->rq_lock);
+  return p;
+}
+
+// the next round-robin process for hart id, returned with its lock
+// held, or 0 if there is none anywhere.
+static struct proc*
+rq_pick(int id)
+{
+  struct cpu *c = &cpus[id], *victim = 0;
+  struct proc *p;
+  int i, len = 0;
+
+  if((p = rq_take(c, id)) == 0){
+    // lengths read without the locks are only a hint.
+    for(i = 0; i < NCPU; i++){
+      if(i != id && cpus[i].rq_len > len){
+        victim = &cpus[i];
+        len = victim->rq_len;
+      }
+    }
+    if(victim == 0 || (p = rq_take(victim, id)) == 0)
+      return 0;
+    c->nsteal++;
+  }
+  // the hart that queued it may still be switching away from it.
+  acquire(&p->lock);
+  if(p->state != RUNNABLE)
+    panic("rq_pick");
+  return p;
+}
+
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
@@ -477,28 +705,36 @@ scheduler(void)
 {
   struct proc *p;
   struct cpu *c = mycpu();
+  int id = cpuid();
   
   c->proc = 0;
+  c->online = 1;
   for(;;){
     // Avoid deadlock by ensuring that devices can interrupt.
     intr_on();
 
-    for(p = proc; p < &proc[NPROC]; p++) {
-      acquire(&p->lock);
-      if(p->state == RUNNABLE) {
-        // Switch to chosen process.  It is the process's job
-        // to release its lock and then reacquire it
-        // before jumping back to us.
-        p->state = RUNNING;
-        c->proc = p;
-        swtch(&c->context, &p->context);
-
-        // Process is done running for now.
-        // It should have changed its p->state before coming back.
-        c->proc = 0;
-      }
-      release(&p->lock);
-    }
+    p = 0;
+    if(dl_nproc > 0)
+      p = dl_pick(id);
+    if(p == 0 && (p = rq_pick(id)) == 0)
+      continue;
+
+    // Switch to chosen process.  It is the process's job
+    // to release its lock and then reacquire it
+    // before jumping back to us.
+    p->state = RUNNING;
+    c->proc = p;
+    c->nswitch++;
+    // for mp3: pending wall-clock timers follow the process.
+    thrdtimer_arm(p);
+    p->run_start = r_time();
+    swtch(&c->context, &p->context);
+    p->cputime += r_time() - p->run_start;
+
+    // Process is done running for now.
+    // It should have changed its p->state before coming back.
+    c->proc = 0;
+    release(&p->lock);
   }
 }
 
@@ -535,7 +771,7 @@ yield(void)
 {
   struct proc *p = myproc();
   acquire(&p->lock);
-  p->state = RUNNABLE;
+  setrunnable(p);
   sched();
   release(&p->lock);
 }
@@ -605,7 +841,8 @@ wakeup(void *chan)
   for(p = proc; p < &proc[NPROC]; p++) {
     acquire(&p->lock);
     if(p->state == SLEEPING && p->chan == chan) {
-      p->state = RUNNABLE;
+      setrunnable(p);
+      dl_wake(p);
     }
     release(&p->lock);
   }
@@ -619,7 +856,8 @@ wakeup1(struct proc *p)
   if(!holding(&p->lock))
     panic("wakeup1");
   if(p->chan == p && p->state == SLEEPING) {
-    p->state = RUNNABLE;
+    setrunnable(p);
+    dl_wake(p);
   }
 }
 
@@ -637,7 +875,8 @@ kill(int pid)
       p->killed = 1;
       if(p->state == SLEEPING){
         // Wake process from sleep().
-        p->state = RUNNABLE;
+        setrunnable(p);
+        dl_wake(p);
       }
       release(&p->lock);
       return 0;
@@ -704,4 +943,8 @@ procdump(void)
     printf("%d %s %s", p->pid, state, p->name);
     printf("\n");
   }
+  for(int i = 0; i < NCPU; i++)
+    if(cpus[i].online)
+      printf("hart %d: queued %d switches %d steals %d\n", i, cpus[i].rq_len,
+             (int)cpus[i].nswitch, (int)cpus[i].nsteal);
 }
@@ -1,9 +1,5 @@
 
 
-// for mp3
-#define MAX_THRD_NUM 16
-
-
 // Saved registers for kernel context switches.
 struct context {
   uint64 ra;
@@ -30,6 +26,15 @@ struct cpu {
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  int online;                 // Has entered scheduler().
+  // round-robin processes waiting for this CPU, FIFO through
+  // proc.rq_next; see setrunnable().
+  struct spinlock rq_lock;
+  struct proc *rq_head;
+  struct proc *rq_tail;
+  int rq_len;
+  uint64 nswitch;             // switches into a process
+  uint64 nsteal;              // processes taken from another CPU's queue
 };
 
 extern struct cpu cpus[NCPU];
@@ -86,6 +91,24 @@ struct trapframe {
   /* 280 */ uint64 t6;
 };
 
+// for mp3
+// a thread context saved by thrdstop/cancelthrdstop, see thrd.c.
+struct thrdctx {
+  struct trapframe tf;
+  int used;
+  int next_free;     // next context on the free list
+};
+
+// a wall-clock timer armed by thrdtimer, see thrd.c.
+struct thrdtimer {
+  uint64 deadline;   // mtime it expires at
+  int context_id;    // where the interrupted context is saved
+  uint64 handler;
+  uint64 arg;
+  int armed;
+  int next;          // next armed timer by deadline, or next free one
+};
+
 enum procstate { UNUSED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
 // Per-process state
@@ -99,18 +122,37 @@ struct proc {
   int killed;                  // If non-zero, have been killed
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
+  int affinity;                // Hart the process must run on, -1 for any
+  uint64 cputime;              // mtime cycles run, up to the last switch out
+  uint64 run_start;            // mtime it was last switched in
+
+  // deadline class, see sched_deadline(); in ticks, 0 runtime if round-robin
+  int dl_runtime;              // budget per period
+  int dl_deadline;             // relative deadline
+  int dl_period;
+  int dl_budget;               // budget left before dl_abs
+  uint dl_abs;                 // absolute deadline
+  int dl_throttled;            // out of budget until the next period
+  uint dl_bw;                  // reserved runtime/deadline, fixed point
+  struct proc *rq_next;        // next on its CPU's run queue, under rq_lock
 
   // for mp3
   int thrdstop_ticks;
   int thrdstop_delay;
+  uint64 thrdstop_deadline;    // mtime a thrdstopus timer expires at, 0 if none
+  uint64 thrdstop_start;       // mtime a thrdstopus timer was set at
   int thrdstop_context_id;
   uint64 thrdstop_handler_arg;
   uint64 thrdstop_handler_pointer;
-  struct trapframe thrdstop_context[MAX_THRD_NUM];
-  int thrdstop_context_used[MAX_THRD_NUM];
+  struct thrdctx **thrdstop_pages; // pages of saved contexts, 0 until first used
+  int thrdstop_nctx;               // contexts in thrdstop_pages
+  int thrdstop_free;               // first free context, -1 if none
   int jump_flag;
   int resume_flag;
   int cancel_save_flag;
+  struct thrdtimer thrdtimers[NTHRDTIMER];
+  int thrdtimer_head;          // earliest armed thrdtimer, -1 if none
+  int thrdtimer_free;          // first free thrdtimer, -1 if none
 
 
   // these are private to the process, so p->lock need not be held.
@@ -11,7 +11,7 @@ void timerinit();
 __attribute__ ((aligned (16))) char stack0[4096 * NCPU];
 
 // a scratch area per CPU for machine-mode timer interrupts.
-uint64 timer_scratch[NCPU][5];
+uint64 timer_scratch[NCPU][TIMER_SCRATCH];
 
 // assembly code in kernelvec.S for machine-mode timer interrupt.
 extern void timervec();
@@ -41,6 +41,12 @@ start()
   // ask for clock interrupts.
   timerinit();
 
+  // let supervisor and user mode read the time CSR (the TM bit),
+  // so user benchmarks like rtbench can time with rdtime instead
+  // of 100ms uptime() ticks.
+  w_mcounteren(r_mcounteren() | 2);
+  w_scounteren(r_scounteren() | 2);
+
   // keep each CPU's hartid in its tp register, for cpuid().
   int id = r_mhartid();
   w_tp(id);
@@ -63,13 +69,15 @@ timerinit()
   int interval = 1000000; // cycles; about 1/10th second in qemu.
   *(uint64*)CLINT_MTIMECMP(id) = *(uint64*)CLINT_MTIME + interval;
 
-  // prepare information in scratch[] for timervec.
-  // scratch[0..2] : space for timervec to save registers.
-  // scratch[3] : address of CLINT MTIMECMP register.
-  // scratch[4] : desired interval (in cycles) between timer interrupts.
+  // prepare information in scratch[] for timervec,
+  // laid out as described in memlayout.h.
   uint64 *scratch = &timer_scratch[id][0];
-  scratch[3] = CLINT_MTIMECMP(id);
-  scratch[4] = interval;
+  scratch[TIMER_MTIMECMP] = CLINT_MTIMECMP(id);
+  scratch[TIMER_INTERVAL] = interval;
+  scratch[TIMER_NEXT] = *(uint64*)CLINT_MTIMECMP(id);
+  scratch[TIMER_ONESHOT] = 0;
+  scratch[TIMER_PENDING] = 0;
+  scratch[TIMER_MTIME] = CLINT_MTIME;
   w_mscratch((uint64)scratch);
 
   // set the machine-mode trap handler.
@@ -109,6 +109,13 @@ extern uint64 sys_uptime(void);
 extern uint64 sys_thrdstop(void);
 extern uint64 sys_thrdresume(void);
 extern uint64 sys_cancelthrdstop(void);
+extern uint64 sys_thrdstopus(void);
+extern uint64 sys_setaffinity(void);
+extern uint64 sys_sched_deadline(void);
+extern uint64 sys_thrdtimer(void);
+extern uint64 sys_cancelthrdtimer(void);
+extern uint64 sys_cpucycles(void);
+extern uint64 sys_schedstat(void);
 
 
 
@@ -139,6 +146,13 @@ static uint64 (*syscalls[])(void) = {
 [SYS_thrdstop]   sys_thrdstop,
 [SYS_thrdresume]   sys_thrdresume,
 [SYS_cancelthrdstop]   sys_cancelthrdstop,
+[SYS_thrdstopus]   sys_thrdstopus,
+[SYS_setaffinity]   sys_setaffinity,
+[SYS_sched_deadline] sys_sched_deadline,
+[SYS_thrdtimer]   sys_thrdtimer,
+[SYS_cancelthrdtimer]   sys_cancelthrdtimer,
+[SYS_cpucycles]   sys_cpucycles,
+[SYS_schedstat]   sys_schedstat,
 };
 
 void
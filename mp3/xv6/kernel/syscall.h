@@ -24,3 +24,10 @@
 #define SYS_thrdstop  22
 #define SYS_thrdresume 23
 #define SYS_cancelthrdstop 24
+#define SYS_thrdstopus 25
+#define SYS_setaffinity 26
+#define SYS_sched_deadline 27
+#define SYS_thrdtimer 28
+#define SYS_cancelthrdtimer 29
+#define SYS_cpucycles 30
+#define SYS_schedstat 31
@@ -95,3 +95,66 @@ sys_uptime(void)
   release(&tickslock);
   return xticks;
 }
+
+// pin the calling process to a running hart, or let it run
+// anywhere again with -1; moves it there before returning.
+uint64
+sys_setaffinity(void)
+{
+  int hart;
+  struct proc *p = myproc();
+
+  if(argint(0, &hart) < 0)
+    return -1;
+  if(hart < -1 || hart >= NCPU || (hart >= 0 && !cpus[hart].online))
+    return -1;
+  acquire(&p->lock);
+  p->affinity = hart;
+  release(&p->lock);
+  if(hart >= 0)
+    yield();
+  return 0;
+}
+
+// join the deadline class, see sched_deadline() in proc.c.
+uint64
+sys_sched_deadline(void)
+{
+  int runtime, deadline, period;
+
+  if(argint(0, &runtime) < 0 || argint(1, &deadline) < 0 || argint(2, &period) < 0)
+    return -1;
+  return sched_deadline(runtime, deadline, period);
+}
+
+// mtime cycles the calling process has run, including this call.
+uint64
+sys_cpucycles(void)
+{
+  struct proc *p = myproc();
+  uint64 t;
+
+  acquire(&p->lock);
+  t = p->cputime + r_time() - p->run_start;
+  release(&p->lock);
+  return t;
+}
+
+// scheduler counters of a running hart: stat[0] gets its context
+// switches and stat[1] the processes it stole from other harts' queues.
+uint64
+sys_schedstat(void)
+{
+  int hart;
+  uint64 addr, stat[2];
+
+  if(argint(0, &hart) < 0 || argaddr(1, &addr) < 0)
+    return -1;
+  if(hart < 0 || hart >= NCPU || !cpus[hart].online)
+    return -1;
+  stat[0] = cpus[hart].nswitch;
+  stat[1] = cpus[hart].nsteal;
+  if(copyout(myproc()->pagetable, addr, (char *)stat, sizeof(stat)) < 0)
+    return -1;
+  return 0;
+}
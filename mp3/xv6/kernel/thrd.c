@@ -8,53 +8,167 @@
 #include "proc.h"
 
 // for mp3
-uint64
-sys_thrdstop(void)
+// a process's thread contexts are kept in pages allocated the first
+// time they are needed and listed in one directory page; free
+// contexts are chained through next_free.
+#define CTX_PER_PAGE ((int)(PGSIZE / sizeof(struct thrdctx)))
+#define CTX_PAGES ((int)(PGSIZE / sizeof(struct thrdctx *)))
+
+static struct thrdctx*
+thrdctx(struct proc *p, int id)
+{
+  if (id < 0 || id >= p->thrdstop_nctx)
+    return 0;
+  return &p->thrdstop_pages[id / CTX_PER_PAGE][id % CTX_PER_PAGE];
+}
+
+struct trapframe*
+thrdstop_context(struct proc *p, int id)
+{
+  struct thrdctx *c = thrdctx(p, id);
+  return c ? &c->tf : 0;
+}
+
+// returns the id of a free context, adding a page of them
+// if none is left, or -1 if out of memory.
+static int
+thrdctx_alloc(struct proc *p)
+{
+  if (p->thrdstop_free < 0) {
+    int n = p->thrdstop_nctx / CTX_PER_PAGE;
+    if (n >= CTX_PAGES)
+      return -1;
+    if (p->thrdstop_pages == 0) {
+      if ((p->thrdstop_pages = (struct thrdctx **)kalloc()) == 0)
+        return -1;
+      memset(p->thrdstop_pages, 0, PGSIZE);
+    }
+    struct thrdctx *page = (struct thrdctx *)kalloc();
+    if (page == 0)
+      return -1;
+    p->thrdstop_pages[n] = page;
+    for (int i = CTX_PER_PAGE - 1; i >= 0; i--) {
+      page[i].used = 0;
+      page[i].next_free = p->thrdstop_free;
+      p->thrdstop_free = p->thrdstop_nctx + i;
+    }
+    p->thrdstop_nctx += CTX_PER_PAGE;
+  }
+
+  int id = p->thrdstop_free;
+  struct thrdctx *c = thrdctx(p, id);
+  p->thrdstop_free = c->next_free;
+  c->used = 1;
+  return id;
+}
+
+static void
+thrdctx_free(struct proc *p, int id)
+{
+  struct thrdctx *c = thrdctx(p, id);
+  if (c == 0 || !c->used)
+    return;
+  c->used = 0;
+  c->next_free = p->thrdstop_free;
+  p->thrdstop_free = id;
+}
+
+void
+thrdstop_freeall(struct proc *p)
+{
+  if (p->thrdstop_pages) {
+    for (int i = 0; i * CTX_PER_PAGE < p->thrdstop_nctx; i++)
+      kfree(p->thrdstop_pages[i]);
+    kfree(p->thrdstop_pages);
+  }
+  p->thrdstop_pages = 0;
+  p->thrdstop_nctx = 0;
+  p->thrdstop_free = -1;
+}
+
+// for mp3
+// reads a context id through the user pointer in argument n,
+// allocating a context if it is negative and writing its id back.
+static int
+thrdctx_arg(int n, int *context_id)
 {
-  int delay, context_id;
   uint64 context_id_ptr;
-  uint64 handler, handler_arg;
-  if (argint(0, &delay) < 0)
-    return -1;
-  if (argaddr(1, &context_id_ptr) < 0)
-    return -1;
-  if (argaddr(2, &handler) < 0)
+  struct proc *proc = myproc();
+
+  if (argaddr(n, &context_id_ptr) < 0)
     return -1;
-  if (argaddr(3, &handler_arg) < 0)
+  if (copyin(proc->pagetable, (char *)context_id, context_id_ptr, sizeof(int)) == -1)
     return -1;
 
-  struct proc *proc = myproc();
-  if (copyin(proc->pagetable, (char *)&context_id, context_id_ptr, sizeof(int)) == -1) {
+  if (*context_id < 0) {
+    if ((*context_id = thrdctx_alloc(proc)) < 0)
+      return -1;
+  } else if (thrdctx(proc, *context_id) == 0) {
     return -1;
   }
 
-  if (context_id < 0) {
-    for (int i = 0; i < MAX_THRD_NUM; i++) {
-      if (proc->thrdstop_context_used[i] == 0) {
-        proc->thrdstop_context_used[i] = 1;
-        context_id = i;
-        break;
-      }
-    }
+  if (copyout(proc->pagetable, context_id_ptr, (char *)context_id, sizeof(int)) == -1)
+    return -1;
+  return 0;
+}
 
-    if (context_id < 0) {
-      return -1;
-    }
-  }
+// for mp3
+// common part of thrdstop and thrdstopus: the timer expires after
+// delay ticks, or at mtime deadline if that is not 0.
+static uint64
+thrdstop_set(int delay, uint64 deadline)
+{
+  int context_id;
+  uint64 handler, handler_arg;
+  if (argaddr(2, &handler) < 0)
+    return -1;
+  if (argaddr(3, &handler_arg) < 0)
+    return -1;
 
-  if (copyout(proc->pagetable, context_id_ptr, (char *)&context_id, sizeof(int)) == -1) {
+  struct proc *proc = myproc();
+  if (thrdctx_arg(1, &context_id) < 0)
     return -1;
-  }
 
   proc->thrdstop_context_id = context_id;
   proc->thrdstop_delay = delay;
+  proc->thrdstop_deadline = deadline;
+  proc->thrdstop_start = deadline ? r_time() : 0;
   proc->thrdstop_handler_pointer = handler;
   proc->thrdstop_ticks = 0;
   proc->thrdstop_handler_arg = handler_arg;
 
+  if (deadline)
+    thrdtimer_arm(proc);
+
   return 0;
 }
 
+// for mp3
+uint64
+sys_thrdstop(void)
+{
+  int delay;
+  if (argint(0, &delay) < 0)
+    return -1;
+
+  return thrdstop_set(delay, 0);
+}
+
+// for mp3
+// like thrdstop, but the delay is in microseconds of wall-clock time
+// and is timed by a one-shot CLINT interrupt instead of ticks.
+uint64
+sys_thrdstopus(void)
+{
+  int delay_us;
+  if (argint(0, &delay_us) < 0)
+    return -1;
+  if (delay_us < 0)
+    return -1;
+
+  return thrdstop_set(-1, r_time() + (uint64)delay_us * (CLINT_HZ / 1000000));
+}
+
 // for mp3
 uint64
 sys_cancelthrdstop(void)
@@ -65,20 +179,24 @@ sys_cancelthrdstop(void)
   if (argint(1, &is_exit) < 0)
     return -1;
 
-  if (context_id < 0 || context_id >= MAX_THRD_NUM) {
+  struct proc *proc = myproc();
+  if (thrdctx(proc, context_id) == 0) {
     return -1;
   }
 
-  struct proc *proc = myproc();
-
-  // cancel previous thrdstop
+  // cancel previous thrdstop; a thrdstopus timer reports
+  // the microseconds it ran instead of ticks.
   int consume_tick = proc->thrdstop_ticks;
+  if (proc->thrdstop_start)
+    consume_tick = (r_time() - proc->thrdstop_start) / (CLINT_HZ / 1000000);
   proc->thrdstop_delay = -1;
+  proc->thrdstop_deadline = 0;
+  proc->thrdstop_start = 0;
 
   if (is_exit == 0) {
     proc->cancel_save_flag = context_id;
-  } else if (context_id >= 0 && context_id < MAX_THRD_NUM) {
-    proc->thrdstop_context_used[context_id] = 0;
+  } else {
+    thrdctx_free(proc, context_id);
   }
 
   return consume_tick;
@@ -94,10 +212,148 @@ sys_thrdresume(void)
 
   struct proc *proc = myproc();
 
-  if (context_id < 0 || context_id >= MAX_THRD_NUM)
+  if (thrdctx(proc, context_id) == 0)
     return -1;
 
   proc->resume_flag = context_id;
 
   return 0;
 }
+
+// for mp3
+// Besides the single thrdstop timer, a process can arm up to NTHRDTIMER
+// wall-clock timers at once with thrdtimer. Armed ones are kept in a
+// list by deadline; on its way back to user space the process takes the
+// earliest that has expired, saving its context and running the handler
+// as thrdstop does. Right after a thrdresume, the context just restored
+// is the one saved, so timers that expire together are delivered one
+// after another in deadline order.
+
+void
+thrdtimer_init(struct proc *p)
+{
+  for (int i = 0; i < NTHRDTIMER; i++) {
+    p->thrdtimers[i].armed = 0;
+    p->thrdtimers[i].next = i + 1 < NTHRDTIMER ? i + 1 : -1;
+  }
+  p->thrdtimer_head = -1;
+  p->thrdtimer_free = 0;
+}
+
+// ask for an interrupt at the earliest wall-clock deadline still
+// ahead of the process; those already past are delivered on the next
+// return to user space anyway.
+void
+thrdtimer_arm(struct proc *p)
+{
+  uint64 now = r_time(), next = 0;
+  int i;
+
+  for (i = p->thrdtimer_head; i >= 0; i = p->thrdtimers[i].next) {
+    if (p->thrdtimers[i].deadline > now) {
+      next = p->thrdtimers[i].deadline;
+      break;
+    }
+  }
+  if (p->thrdstop_deadline > now && (next == 0 || p->thrdstop_deadline < next))
+    next = p->thrdstop_deadline;
+  if (next)
+    timer_oneshot(next);
+}
+
+// removes timer id from the list of armed timers.
+static void
+thrdtimer_unlink(struct proc *p, int id)
+{
+  int *link = &p->thrdtimer_head;
+  while (*link != id)
+    link = &p->thrdtimers[*link].next;
+  *link = p->thrdtimers[id].next;
+  p->thrdtimers[id].armed = 0;
+  p->thrdtimers[id].next = p->thrdtimer_free;
+  p->thrdtimer_free = id;
+}
+
+// called from usertrapret: if the earliest timer has expired, save
+// the user context for it and send the process to its handler.
+// returns 1 if it did.
+int
+thrdtimer_deliver(struct proc *p)
+{
+  int id = p->thrdtimer_head;
+  if (id < 0 || p->thrdtimers[id].deadline > r_time())
+    return 0;
+
+  struct thrdtimer *t = &p->thrdtimers[id];
+  struct thrdctx *c = thrdctx(p, t->context_id);
+  uint64 handler = t->handler, arg = t->arg;
+  thrdtimer_unlink(p, id);
+  // the context was freed since the timer was armed.
+  if (c == 0 || !c->used)
+    return 0;
+
+  memmove(&c->tf, p->trapframe, sizeof(struct trapframe));
+  p->trapframe->epc = handler;
+  p->trapframe->a0 = arg;
+  return 1;
+}
+
+// for mp3
+// arm another timer that expires after delay_us microseconds of
+// wall-clock time; returns its id for cancelthrdtimer, or -1.
+uint64
+sys_thrdtimer(void)
+{
+  int delay_us, context_id;
+  uint64 handler, handler_arg;
+  if (argint(0, &delay_us) < 0 || delay_us < 0)
+    return -1;
+  if (argaddr(2, &handler) < 0)
+    return -1;
+  if (argaddr(3, &handler_arg) < 0)
+    return -1;
+
+  struct proc *proc = myproc();
+  if (proc->thrdtimer_free < 0)
+    return -1;
+  if (thrdctx_arg(1, &context_id) < 0)
+    return -1;
+
+  int id = proc->thrdtimer_free;
+  struct thrdtimer *t = &proc->thrdtimers[id];
+  proc->thrdtimer_free = t->next;
+  t->deadline = r_time() + (uint64)delay_us * (CLINT_HZ / 1000000);
+  t->context_id = context_id;
+  t->handler = handler;
+  t->arg = handler_arg;
+  t->armed = 1;
+
+  // after any timer with the same deadline, so those go in arming order.
+  int *link = &proc->thrdtimer_head;
+  while (*link >= 0 && proc->thrdtimers[*link].deadline <= t->deadline)
+    link = &proc->thrdtimers[*link].next;
+  t->next = *link;
+  *link = id;
+
+  thrdtimer_arm(proc);
+  return id;
+}
+
+// for mp3
+// disarm a thrdtimer; returns the microseconds it had left,
+// or -1 if it is not armed, e.g. because it already expired.
+uint64
+sys_cancelthrdtimer(void)
+{
+  int id;
+  if (argint(0, &id) < 0)
+    return -1;
+
+  struct proc *proc = myproc();
+  if (id < 0 || id >= NTHRDTIMER || !proc->thrdtimers[id].armed)
+    return -1;
+
+  uint64 now = r_time(), deadline = proc->thrdtimers[id].deadline;
+  thrdtimer_unlink(proc, id);
+  return deadline > now ? (deadline - now) / (CLINT_HZ / 1000000) : 0;
+}
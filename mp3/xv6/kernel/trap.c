@@ -15,6 +15,7 @@ extern char trampoline[], uservec[], userret[];
 void kernelvec();
 
 extern int devintr();
+extern uint64 timer_scratch[NCPU][TIMER_SCRATCH];
 
 void
 trapinit(void)
@@ -29,6 +30,28 @@ trapinithart(void)
   w_stvec((uint64)kernelvec);
 }
  
+// for mp3
+// a thrdstop timer expires after thrdstop_delay ticks of the
+// process, or once mtime reaches thrdstop_deadline.
+static void
+thrdstop_timer(struct proc *p, int tick)
+{
+  if(tick && p->thrdstop_delay > 0){
+    p->thrdstop_ticks++;
+    if(p->thrdstop_ticks >= p->thrdstop_delay){
+      p->thrdstop_delay = -1;
+      p->jump_flag = 1;
+    }
+  }
+  if(p->thrdstop_deadline && r_time() >= p->thrdstop_deadline){
+    p->thrdstop_deadline = 0;
+    p->jump_flag = 1;
+  }
+  // a one-shot is used up once it fires; ask for the next one.
+  if(!tick)
+    thrdtimer_arm(p);
+}
+
 //
 // handle an interrupt, exception, or system call from user space.
 // called from trampoline.S
@@ -76,16 +99,13 @@ usertrap(void)
   if(p->killed)
     exit(-1);
 
+  // for mp3
+  if(which_dev == 2 || which_dev == 3)
+    thrdstop_timer(p, which_dev == 2);
+
   // give up the CPU if this is a timer interrupt.
   if(which_dev == 2){
-    // for mp3
-    if(p->thrdstop_delay > 0){
-      p->thrdstop_ticks++;
-      if(p->thrdstop_ticks >= p->thrdstop_delay){
-        p->thrdstop_delay = -1;
-        p->jump_flag = 1;
-      }
-    }
+    dl_tick(p);
     yield();
   }
   usertrapret();
@@ -107,28 +127,32 @@ usertrapret(void)
   // send syscalls, interrupts, and exceptions to trampoline.S
   w_stvec(TRAMPOLINE + (uservec - trampoline));
 
+  int jumped = 0;
   if(p->resume_flag != -1){ // handle thrdresume
     // restore user context
-    struct trapframe *now_thrd_context = &(p->thrdstop_context[p->resume_flag]);
+    struct trapframe *now_thrd_context = thrdstop_context(p, p->resume_flag);
     memmove(p->trapframe, now_thrd_context, sizeof(struct trapframe));
     // clear falg
     p->resume_flag = -1;
   }else if(p->jump_flag == 1){ // handle thrdstop
     // save user context
-    struct trapframe *now_thrd_context = &(p->thrdstop_context[p->thrdstop_context_id]);
+    struct trapframe *now_thrd_context = thrdstop_context(p, p->thrdstop_context_id);
     memmove(now_thrd_context, p->trapframe, sizeof(struct trapframe));
     // clear flag
     p->jump_flag = 0;
     // set pc to handler function
     p->trapframe->epc = p->thrdstop_handler_pointer;
     p->trapframe->a0 = p->thrdstop_handler_arg;
+    jumped = 1;
   }else if(p->cancel_save_flag != -1){ // handle cancelthrdstop
     // save user context
-    struct trapframe *now_thrd_context = &(p->thrdstop_context[p->cancel_save_flag]);
+    struct trapframe *now_thrd_context = thrdstop_context(p, p->cancel_save_flag);
     memmove(now_thrd_context, p->trapframe, sizeof(struct trapframe));
     // clear flag
     p->cancel_save_flag = -1;
   }
+  if(!jumped) // handle an expired thrdtimer
+    thrdtimer_deliver(p);
 
   // set up trapframe values that uservec will need when
   // the process next re-enters the kernel.
@@ -182,18 +206,13 @@ kerneltrap()
     panic("kerneltrap");
   }
 
+  // for mp3
+  if((which_dev == 2 || which_dev == 3) && myproc() != 0 && myproc()->state == RUNNING)
+    thrdstop_timer(myproc(), which_dev == 2);
+
   // give up the CPU if this is a timer interrupt.
   if(which_dev == 2 && myproc() != 0 && myproc()->state == RUNNING){
-    // for mp3
-    struct proc *p = myproc();
-
-    if(p->thrdstop_delay > 0){
-      p->thrdstop_ticks++;
-      if(p->thrdstop_ticks >= p->thrdstop_delay){
-        p->jump_flag = 1;
-        p->thrdstop_delay = -1;
-      }
-    }
+    dl_tick(myproc());
     yield();
   }
 
@@ -213,9 +232,27 @@ clockintr()
   release(&tickslock);
 }
 
+// for mp3
+// ask timervec for an extra interrupt on this hart once
+// mtime reaches deadline, replacing any earlier request.
+void
+timer_oneshot(uint64 deadline)
+{
+  push_off();
+  int id = cpuid();
+  timer_scratch[id][TIMER_ONESHOT] = deadline;
+  __sync_synchronize();
+  // timervec recomputes mtimecmp whenever it runs, so
+  // pulling mtimecmp into the past makes it see the deadline.
+  if(deadline < *(uint64*)CLINT_MTIMECMP(id))
+    *(uint64*)CLINT_MTIMECMP(id) = 0;
+  pop_off();
+}
+
 // check if it's an external interrupt or software interrupt,
 // and handle it.
 // returns 2 if timer interrupt,
+// 3 if a timer interrupt without a tick (a one-shot),
 // 1 if other device,
 // 0 if not recognized.
 int
@@ -248,8 +285,9 @@ devintr()
   } else if(scause == 0x8000000000000001L){
     // software interrupt from a machine-mode timer interrupt,
     // forwarded by timervec in kernelvec.S.
+    int ticked = __sync_lock_test_and_set(&timer_scratch[cpuid()][TIMER_PENDING], 0) != 0;
 
-    if(cpuid() == 0){
+    if(ticked && cpuid() == 0){
       clockintr();
     }
     
@@ -257,7 +295,7 @@ devintr()
     // the SSIP bit in sip.
     w_sip(r_sip() & ~2);
 
-    return 2;
+    return ticked ? 2 : 3;
   } else {
     return 0;
   }
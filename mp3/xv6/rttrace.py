@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+
+# Reads the scheduling trace that a threads run dumps after trace_start()
+# (user/trace.h) out of a console log such as xv6.out, and prints a Gantt
+# chart plus per-thread response time, jitter and lateness, and the time
+# the policy took per decision.
+#
+#   python3 rttrace.py xv6.out
+#
+# Gantt rows have one column per tick: '#' running, '.' released and
+# waiting, 't' throttled by CBS, '!' deadline missed, 'x' job dropped.
+
+import struct
+import sys
+
+RELEASE, DISPATCH, PREEMPT, FINISH, EXIT, MISS, THROTTLE, REPLENISH, IDLE, PICK, DROP, MODE = range(1, 13)
+RECORD = struct.Struct("<Qiiii")  # struct trace_event
+CLOCK_HZ = 10000000               # rdtime frequency under qemu
+
+def read_traces(path):
+    traces, events = [], None
+    with open(path, errors="replace") as f:
+        for line in f:
+            line = line.strip()
+            if not line.startswith("trace: "):
+                continue
+            body = line[len("trace: "):]
+            if body.startswith("begin"):
+                events = []
+            elif body == "end":
+                if events is not None:
+                    traces.append(events)
+                events = None
+            elif events is not None and len(body) == 2 * RECORD.size:
+                cycles, time, arg, kind, tid = RECORD.unpack(bytes.fromhex(body))
+                events.append((kind, tid, time, arg, cycles))
+    return traces
+
+def running_intervals(events):
+    # a dispatch runs until that thread is preempted, finishes, exits, misses
+    # or has its job dropped
+    runs, open_run = [], {}
+    for kind, tid, time, arg, _ in events:
+        if kind == DISPATCH:
+            open_run[tid] = time
+        elif kind in (PREEMPT, FINISH, EXIT, MISS, DROP) and tid in open_run:
+            start = open_run.pop(tid)
+            if time > start:
+                runs.append((tid, start, time))
+    return runs
+
+def gantt(events):
+    tids = sorted({e[1] for e in events if e[1]})
+    end = max([e[2] for e in events] + [0])
+    rows = {tid: [" "] * end for tid in tids}
+    waiting, throttled = {}, {}
+    for kind, tid, time, arg, _ in events:
+        if kind == RELEASE:
+            waiting.setdefault(tid, []).append(time)
+        elif kind in (FINISH, DROP) and waiting.get(tid):
+            start = waiting[tid].pop(0)
+            for t in range(start, min(time, end)):
+                rows[tid][t] = "."
+        elif kind == THROTTLE:
+            throttled[tid] = time
+        elif kind == REPLENISH and tid in throttled:
+            for t in range(throttled.pop(tid), min(time, end)):
+                rows[tid][t] = "t"
+    for tid, start, stop in running_intervals(events):
+        for t in range(start, min(stop, end)):
+            rows[tid][t] = "#"
+    for kind, tid, time, arg, _ in events:
+        if kind == MISS and tid in rows:
+            rows[tid][min(time, end) - 1] = "!"
+        elif kind == DROP and tid in rows and time > 0:
+            rows[tid][min(time, end) - 1] = "x"
+
+    width = len("thread#%d" % max(tids + [0]))
+    axis = "".join(str(t // 10 % 10) if t % 10 == 0 else " " for t in range(end))
+    print("%s |%s|" % ("tick".ljust(width), axis))
+    for tid in tids:
+        print("%s |%s|" % (("thread#%d" % tid).ljust(width), "".join(rows[tid])))
+
+def report(events):
+    jobs, stats = {}, {}
+    for kind, tid, time, arg, _ in events:
+        if kind == RELEASE:
+            jobs.setdefault(tid, []).append((time, arg))
+        elif kind == FINISH and jobs.get(tid):
+            release, deadline = jobs[tid].pop(0)
+            stats.setdefault(tid, []).append((time - release, time - deadline))
+        elif kind == DROP and jobs.get(tid):
+            # neither a response nor a miss
+            jobs[tid].pop(0)
+        elif kind == MISS:
+            stats.setdefault(tid, []).append((None, time - arg))
+
+    print("thread  jobs  resp.min  resp.avg  resp.max  jitter  lateness.max  misses")
+    for tid in sorted(stats):
+        done = [r for r, _ in stats[tid] if r is not None]
+        late = max(l for _, l in stats[tid])
+        misses = sum(1 for r, l in stats[tid] if r is None or l > 0)
+        if done:
+            print("%6d %5d %9d %9.1f %9d %7d %13d %7d" % (
+                tid, len(done), min(done), sum(done) / len(done), max(done),
+                max(done) - min(done), late, misses))
+        else:
+            print("%6d %5d %9s %9s %9s %7s %13d %7d" % (tid, 0, "-", "-", "-", "-", late, misses))
+
+    for kind, tid, time, arg, _ in events:
+        if kind == MODE and arg:
+            print("criticality: high at %d, thread#%d overran" % (time, tid))
+        elif kind == MODE:
+            print("criticality: low at %d" % time)
+
+    picks = [arg for kind, _, _, arg, _ in events if kind == PICK]
+    if picks and len(events) > 1:
+        span = events[-1][4] - events[0][4]
+        share = 100.0 * sum(picks) / span if span > 0 else 0.0
+        print("scheduler: %d decisions, avg %.1f max %d cycles (%.1fus), %.2f%% of the traced time" % (
+            len(picks), sum(picks) / len(picks), max(picks),
+            1e6 * max(picks) / CLOCK_HZ, share))
+
+def main():
+    if len(sys.argv) != 2:
+        print("usage: rttrace.py <console log>", file=sys.stderr)
+        sys.exit(1)
+    traces = read_traces(sys.argv[1])
+    if not traces:
+        print("rttrace: no trace in %s" % sys.argv[1], file=sys.stderr)
+        sys.exit(1)
+    for i, events in enumerate(traces):
+        if len(traces) > 1:
+            print("trace %d" % (i + 1))
+        gantt(events)
+        print()
+        report(events)
+
+if __name__ == "__main__":
+    main()
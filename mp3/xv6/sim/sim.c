@@ -0,0 +1,307 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/list.h"
+#include "user/heap.h"
+#include "user/threads.h"
+#include "user/threads_sched.h"
+#include "user/rtanalysis.h"
+#include "user/trace.h"
+
+// Discrete-event simulator for the threads_sched.c policies, built for
+// the host from the same sources (make sim/sim). Random periodic task
+// sets, utilizations drawn with UUniFast and periods log-uniform, run
+// under every policy in thread_schedulers from a synchronous release,
+// with the run queue handled as threads.c does. A deadline miss drops
+// the job rather than ending the run. Jobs are released until the
+// horizon, and every released job counts. One line per utilization and
+// policy:
+//   sim: U=<u> <policy> sets=<n> jobs=<n> miss_ratio=<r> missed_sets=<n> preemptions=<per set> pick_ns=<ns> admitted=<n> unsound=<n>
+// For a policy with an admission test, admitted is the number of sets it
+// passes and unsound the number of those that still missed a deadline.
+//   sim/sim [-n tasks] [-s sets] [-u utilization] [-t horizon] [-r seed]
+
+#define PERIOD_MIN 10
+#define PERIOD_MAX 100
+#define TIME_QUANTUM 2
+
+struct stats {
+    long jobs;
+    long misses;
+    long missed_sets;
+    long preemptions;
+    long decisions;
+    long admitted;
+    long unsound;
+    double pick_ns;
+};
+
+static uint64 rng_state = 88172645463325252UL;
+
+// xorshift64, so a seed gives the same sets on every host
+static double rand01(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (rng_state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// n utilizations summing to total, uniformly distributed (Bini & Buttazzo)
+static void uunifast(double *u, int n, double total)
+{
+    double sum = total, next;
+    int i;
+    for (i = 0; i < n - 1; i++) {
+        next = sum * pow(rand01(), 1.0 / (n - i - 1));
+        u[i] = sum - next;
+        sum = next;
+    }
+    u[n - 1] = sum;
+}
+
+static void task_set(struct rt_task *ts, int n, double total)
+{
+    double u[n];
+    int i;
+
+    uunifast(u, n, total);
+    for (i = 0; i < n; i++) {
+        double lo = log(PERIOD_MIN), hi = log(PERIOD_MAX + 1);
+        ts[i].id = i + 1;
+        ts[i].period = (int)exp(lo + (hi - lo) * rand01());
+        ts[i].wcet = (int)(u[i] * ts[i].period + 0.5);
+        if (ts[i].wcet < 1)
+            ts[i].wcet = 1;
+        ts[i].deadline = ts[i].period;
+        ts[i].budget = 0;
+        ts[i].blocking = 0;
+        ts[i].jitter = 0;
+        ts[i].wcet_hi = 0;
+    }
+}
+
+static int release_before(void *a, void *b)
+{
+    struct release_queue_entry *x = a, *y = b;
+    if (x->release_time != y->release_time)
+        return x->release_time < y->release_time;
+    return x->seq < y->seq;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void release(struct heap *release_queue, struct release_queue_entry *e, int at, int horizon, int *seq)
+{
+    if (at >= horizon)
+        return;
+    e->release_time = at;
+    e->seq = (*seq)++;
+    heap_push(release_queue, e);
+}
+
+// the job of t leaves the run queue, finished or dropped after a miss
+static void retire(struct thread_sched_ops *ops, struct thread *t, struct heap *release_queue,
+                   struct release_queue_entry *e, int horizon, int *seq)
+{
+    list_del(&t->thread_list);
+    if (ops->on_finish)
+        ops->on_finish(t);
+    release(release_queue, e, t->current_deadline, horizon, seq);
+}
+
+// returns the number of jobs that missed their deadline
+static long simulate(struct thread_sched_ops *ops, struct rt_task *ts, int n, int horizon, struct stats *st)
+{
+    LIST_HEAD(run_queue);
+    struct heap release_queue = HEAP_INIT(release_before, NULL);
+    struct thread *th = calloc(n, sizeof(struct thread));
+    struct release_queue_entry *ent = calloc(n, sizeof(struct release_queue_entry));
+    struct release_queue_entry *e;
+    struct threads_sched_result r;
+    struct thread *t, *preempted = NULL;
+    long misses = 0;
+    int now = 0, seq = 0, i;
+    double t0;
+
+    for (i = 0; i < n; i++) {
+        th[i].ID = ts[i].id;
+        th[i].is_real_time = 1;
+        th[i].processing_time = ts[i].wcet;
+        th[i].period = th[i].effective_period = ts[i].period;
+        th[i].deadline = ts[i].deadline;
+        th[i].priority = i < 16 ? i : 15;
+        th[i].cbs.budget = th[i].cbs.remaining_budget = ts[i].wcet;
+        th[i].cbs.is_hard_rt = 1;
+        th[i].mc.wcet_lo = th[i].mc.wcet_hi = ts[i].wcet;
+        th[i].rq_index = th[i].dl_index = -1;
+        INIT_LIST_HEAD(&th[i].rt_list);
+        INIT_LIST_HEAD(&th[i].held);
+        ent[i].thrd = &th[i];
+        release(&release_queue, &ent[i], 0, horizon, &seq);
+    }
+
+    while (!list_empty(&run_queue) || !heap_empty(&release_queue)) {
+        while ((e = heap_top(&release_queue)) != NULL && now >= e->release_time) {
+            heap_pop(&release_queue);
+            e->thrd->remaining_time = e->thrd->processing_time;
+            e->thrd->arrival_time = e->release_time;
+            e->thrd->current_deadline = e->release_time + e->thrd->deadline;
+            list_add_tail(&e->thrd->thread_list, &run_queue);
+            if (ops->on_release)
+                ops->on_release(e->thrd);
+        }
+        struct threads_sched_args args = {
+            .time_quantum = TIME_QUANTUM,
+            .current_time = now,
+            .run_queue = &run_queue,
+            .release_queue = &release_queue,
+        };
+        t0 = now_ns();
+        r = ops->pick(args);
+        st->pick_ns += now_ns() - t0;
+        st->decisions++;
+
+        if (r.scheduled_thread_list_member == &run_queue) {
+            e = heap_top(&release_queue);
+            if (r.allocated_time > 0)
+                now += r.allocated_time;
+            else if (e != NULL)
+                now = e->release_time;
+            else
+                break;
+            continue;
+        }
+
+        t = list_entry(r.scheduled_thread_list_member, struct thread, thread_list);
+        if (preempted != NULL && preempted != t)
+            st->preemptions++;
+        preempted = NULL;
+        if (r.allocated_time == 0) {
+            // the policy reports a missed deadline this way
+            misses++;
+            st->jobs++;
+            retire(ops, t, &release_queue, &ent[t - th], horizon, &seq);
+            continue;
+        }
+
+        now += r.allocated_time;
+        t->remaining_time -= r.allocated_time;
+        if (ops->on_tick)
+            ops->on_tick(t, r.allocated_time);
+        if (now > t->current_deadline || (now == t->current_deadline && t->remaining_time > 0)) {
+            misses++;
+            st->jobs++;
+            retire(ops, t, &release_queue, &ent[t - th], horizon, &seq);
+        } else if (t->remaining_time > 0) {
+            list_del(&t->thread_list);
+            list_add_tail(&t->thread_list, &run_queue);
+            preempted = t;
+        } else {
+            st->jobs++;
+            retire(ops, t, &release_queue, &ent[t - th], horizon, &seq);
+        }
+    }
+
+    // a decision far in the future with nothing queued lets a policy drop
+    // what it still tracks, e.g. EDF_GRUB's inactive bandwidth
+    struct threads_sched_args drain = {
+        .time_quantum = TIME_QUANTUM,
+        .current_time = INT_MAX / 2,
+        .run_queue = &run_queue,
+        .release_queue = &release_queue,
+    };
+    ops->pick(drain);
+
+    st->misses += misses;
+    if (misses > 0)
+        st->missed_sets++;
+    free(release_queue.items);
+    free(th);
+    free(ent);
+    return misses;
+}
+
+// threads.c records the trace; here the policies' events go nowhere
+void trace_record(int type, int tid, int time, int arg)
+{
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: sim [-n tasks] [-s sets] [-u utilization] [-t horizon] [-r seed]\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    int ntasks = 5, sets = 1000, horizon = 1000, npolicies = 0;
+    double only = 0, u, t0;
+    long runs = 0, misses;
+    int c, i, p, q;
+
+    while ((c = getopt(argc, argv, "n:s:u:t:r:")) != -1) {
+        switch (c) {
+        case 'n': ntasks = atoi(optarg); break;
+        case 's': sets = atoi(optarg); break;
+        case 'u': only = atof(optarg); break;
+        case 't': horizon = atoi(optarg); break;
+        case 'r': rng_state = strtoull(optarg, NULL, 0) | 1; break;
+        default: usage();
+        }
+    }
+    if (ntasks < 1 || sets < 1 || horizon < 1 || only < 0)
+        usage();
+
+    while (thread_schedulers[npolicies] != NULL)
+        npolicies++;
+    struct stats st[npolicies];
+    struct rt_task ts[ntasks];
+    int admitted[npolicies];
+
+    t0 = now_ns();
+    for (u = only > 0 ? only : 0.5; u < (only > 0 ? only : 1.0) + 1e-9; u += 0.05) {
+        memset(st, 0, sizeof(st));
+        for (i = 0; i < sets; i++) {
+            task_set(ts, ntasks, u);
+            for (p = 0; p < npolicies; p++) {
+                struct thread_sched_ops *ops = thread_schedulers[p];
+                misses = simulate(ops, ts, ntasks, horizon, &st[p]);
+                runs++;
+                if (ops->admit == NULL)
+                    continue;
+                // policies sharing a test share its verdict; the EDF test
+                // is by far the slowest part of a run
+                for (q = 0; q < p && thread_schedulers[q]->admit != ops->admit; q++)
+                    ;
+                admitted[p] = q < p ? admitted[q] : ops->admit(ts, ntasks);
+                if (admitted[p]) {
+                    st[p].admitted++;
+                    if (misses > 0)
+                        st[p].unsound++;
+                }
+            }
+        }
+        for (p = 0; p < npolicies; p++) {
+            printf("sim: U=%.2f %s sets=%d jobs=%ld miss_ratio=%.4f missed_sets=%ld preemptions=%.1f pick_ns=%.0f",
+                   u, thread_schedulers[p]->name, sets, st[p].jobs,
+                   st[p].jobs ? (double)st[p].misses / st[p].jobs : 0.0, st[p].missed_sets,
+                   (double)st[p].preemptions / sets, st[p].decisions ? st[p].pick_ns / st[p].decisions : 0.0);
+            if (thread_schedulers[p]->admit != NULL)
+                printf(" admitted=%ld unsound=%ld", st[p].admitted, st[p].unsound);
+            printf("\n");
+        }
+    }
+    printf("sim: %ld runs in %.0f ms\n", runs, (now_ns() - t0) / 1e6);
+    return 0;
+}
@@ -0,0 +1,13 @@
+#ifndef SIM_USER_H_
+#define SIM_USER_H_
+
+// Native stand-in for user/user.h when sim/ is on the include path first:
+// the policies and the analysis only need the allocator and memmove,
+// which come from the host libc here.
+#include <stdlib.h>
+#include <string.h>
+
+// list.h and the sources define it as 0, as under xv6
+#undef NULL
+
+#endif // SIM_USER_H_
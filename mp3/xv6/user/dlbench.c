@@ -0,0 +1,120 @@
+#include "kernel/types.h"
+#include "user/user.h"
+
+// A periodic process among CPU hogs, first as an ordinary round-robin
+// process and then in the kernel's deadline class. Each job needs WORK
+// ticks of CPU, counted as ticks the process saw go by one at a time, so
+// ticks spent preempted do not count. Run with one hart (the default) so
+// the hogs compete with it. Times in ticks:
+//   bench: dl.<class> jobs=<n> misses=<n> resp_avg=<t> resp_max=<t>
+// and then whether admission turned away a second reservation that
+// does not fit:
+//   bench: dl.admission first=<0|-1> second=<0|-1>
+
+#define NHOGS 4
+#define WORK 3
+#define PERIOD 10
+#define NJOBS 20
+
+static void hog(void)
+{
+    volatile int k = 0;
+    while (1)
+        k++;
+}
+
+// busy until it has run for n whole ticks
+static void work(int n)
+{
+    int last = uptime(), now;
+    while (n > 0) {
+        now = uptime();
+        if (now == last + 1)
+            n--;
+        last = now;
+    }
+}
+
+static void job_loop(char *class)
+{
+    int release = uptime() + 1, now, resp, total = 0, max = 0, misses = 0, i;
+
+    for (i = 0; i < NJOBS; i++) {
+        now = uptime();
+        if (now < release)
+            sleep(release - now);
+        work(WORK);
+        resp = uptime() - release;
+        total += resp;
+        if (resp > max)
+            max = resp;
+        if (resp > PERIOD)
+            misses++;
+        release += PERIOD;
+        // an overrun skips the releases it covered
+        while (release < uptime())
+            release += PERIOD;
+    }
+    printf("bench: dl.%s jobs=%d misses=%d resp_avg=%d.%d resp_max=%d\n", class, NJOBS, misses,
+           total / NJOBS, total * 10 / NJOBS % 10, max);
+}
+
+static void run(int deadline)
+{
+    int hogs[NHOGS], i;
+
+    for (i = 0; i < NHOGS; i++) {
+        if ((hogs[i] = fork()) == 0)
+            hog();
+    }
+    if (fork() == 0) {
+        // a tick on top of WORK for the one the job starts partway into
+        if (deadline && sched_deadline(WORK + 1, PERIOD, PERIOD) < 0) {
+            printf("dlbench: sched_deadline failed\n");
+            exit(1);
+        }
+        job_loop(deadline ? "deadline" : "rr");
+        exit(0);
+    }
+    wait(0);
+    for (i = 0; i < NHOGS; i++) {
+        kill(hogs[i]);
+        wait(0);
+    }
+}
+
+static void admission(void)
+{
+    int up[2], down[2], first, second;
+    char c;
+
+    pipe(up);
+    pipe(down);
+    if (fork() == 0) {
+        first = sched_deadline(6, 10, 10);
+        write(up[1], &first, sizeof(first));
+        // hold the reservation until the parent has tried its own
+        read(down[0], &c, 1);
+        exit(0);
+    }
+    read(up[0], &first, sizeof(first));
+    second = sched_deadline(6, 10, 10);
+    printf("bench: dl.admission first=%d second=%d\n", first, second);
+    if (second == 0)
+        sched_deadline(0, 0, 0);
+    write(down[1], "x", 1);
+    wait(0);
+    close(up[0]);
+    close(up[1]);
+    close(down[0]);
+    close(down[1]);
+}
+
+int main(int argc, char **argv)
+{
+    printf("dlbench\n");
+    run(0);
+    run(1);
+    admission();
+    exit(0);
+}
@@ -0,0 +1,170 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/list.h"
+#include "user/heap.h"
+#include "user/threads.h"
+#include "user/threads_sched.h"
+
+#define NULL 0
+#define TIME_QUANTUM 2
+#define JOBS 30
+
+// Response times under EDF_CBS with and without GRUB reclaiming. Each
+// set mixes hard threads with soft ones whose jobs overrun their CBS
+// budget. The threads are simulated as rtbench does, but every job runs
+// its full processing time, so budgets drain and throttle as in threads.c.
+// Averages are in ticks, one line per set and policy:
+//   bench: reclaim.<set> <policy> soft_avg=<t> soft_max=<t> hard_avg=<t> hard_max=<t> misses=<n>
+
+struct task {
+    int hard;
+    int wcet;
+    int budget; // the CBS budget, wcet for a hard thread
+    int period;
+};
+
+struct task_set {
+    char *name;
+    int n;
+    struct task tasks[4];
+};
+
+static struct task_set sets[] = {
+    { "overrun", 2, { { 1, 2, 2, 10 }, { 0, 4, 2, 8 } } },
+    { "mixed", 4, { { 1, 3, 3, 10 }, { 1, 2, 2, 15 }, { 0, 5, 3, 12 }, { 0, 3, 1, 6 } } },
+    { "loaded", 3, { { 1, 4, 4, 8 }, { 0, 4, 2, 12 }, { 0, 2, 1, 10 } } },
+};
+
+struct acc {
+    int total;
+    int max;
+    int n;
+};
+
+static int release_before(void *a, void *b)
+{
+    struct release_queue_entry *x = a, *y = b;
+    if (x->release_time != y->release_time)
+        return x->release_time < y->release_time;
+    return x->seq < y->seq;
+}
+
+static void add(struct acc *a, int v)
+{
+    a->total += v;
+    if (v > a->max)
+        a->max = v;
+    a->n++;
+}
+
+// average in tenths of a tick
+static void print_avg(char *label, struct acc *a)
+{
+    int tenths = a->n ? a->total * 10 / a->n : 0;
+    printf(" %s_avg=%d.%d %s_max=%d", label, tenths / 10, tenths % 10, label, a->max);
+}
+
+static void run(struct thread_sched_ops *ops, struct task_set *set)
+{
+    LIST_HEAD(run_queue);
+    struct heap release_queue = HEAP_INIT(release_before, NULL);
+    struct thread *th = (struct thread *)malloc(set->n * sizeof(struct thread));
+    struct release_queue_entry *ent = malloc(set->n * sizeof(struct release_queue_entry));
+    int *released = malloc(set->n * sizeof(int));
+    struct release_queue_entry *e;
+    struct threads_sched_result r;
+    struct acc soft = { 0, 0, 0 }, hard = { 0, 0, 0 };
+    int now = 0, seq = 0, misses = 0, i;
+
+    memset(th, 0, set->n * sizeof(struct thread));
+    for (i = 0; i < set->n; i++) {
+        struct task *k = &set->tasks[i];
+        th[i].ID = i + 1;
+        th[i].is_real_time = 1;
+        th[i].processing_time = k->wcet;
+        th[i].period = th[i].deadline = th[i].effective_period = k->period;
+        th[i].n = JOBS;
+        th[i].cbs.budget = th[i].cbs.remaining_budget = k->budget;
+        th[i].cbs.is_hard_rt = k->hard;
+        ent[i].thrd = &th[i];
+        ent[i].release_time = 0;
+        ent[i].seq = seq++;
+        heap_push(&release_queue, &ent[i]);
+    }
+
+    while (!list_empty(&run_queue) || !heap_empty(&release_queue)) {
+        while ((e = heap_top(&release_queue)) != NULL && now >= e->release_time) {
+            heap_pop(&release_queue);
+            e->thrd->remaining_time = e->thrd->processing_time;
+            e->thrd->current_deadline = e->release_time + e->thrd->deadline;
+            released[e->thrd - th] = e->release_time;
+            list_add_tail(&e->thrd->thread_list, &run_queue);
+            ops->on_release(e->thrd);
+        }
+        struct threads_sched_args args = {
+            .time_quantum = TIME_QUANTUM,
+            .current_time = now,
+            .run_queue = &run_queue,
+            .release_queue = &release_queue,
+        };
+        r = ops->pick(args);
+        if (r.scheduled_thread_list_member == &run_queue) {
+            now += r.allocated_time > 0 ? r.allocated_time : 1;
+            continue;
+        }
+
+        struct thread *t = list_entry(r.scheduled_thread_list_member, struct thread, thread_list);
+        if (r.allocated_time == 0) {
+            // a hard job past its deadline: count it and drop the job
+            misses++;
+            t->remaining_time = 0;
+        } else {
+            now += r.allocated_time;
+            t->remaining_time -= r.allocated_time;
+            ops->on_tick(t, r.allocated_time);
+        }
+        list_del(&t->thread_list);
+        if (t->remaining_time > 0) {
+            list_add_tail(&t->thread_list, &run_queue);
+            continue;
+        }
+
+        if (r.allocated_time > 0)
+            add(t->cbs.is_hard_rt ? &hard : &soft, now - released[t - th]);
+        ops->on_finish(t);
+        if (--t->n > 0) {
+            e = &ent[t - th];
+            e->release_time = t->current_deadline;
+            e->seq = seq++;
+            heap_push(&release_queue, e);
+        }
+    }
+
+    printf("bench: reclaim.%s %s", set->name, ops->name);
+    print_avg("soft", &soft);
+    print_avg("hard", &hard);
+    printf(" misses=%d\n", misses);
+    free(release_queue.items);
+    free(released);
+    free(ent);
+    free(th);
+}
+
+int main(int argc, char **argv)
+{
+    struct thread_sched_ops *policies[] = { &sched_edf_cbs, &sched_edf_grub };
+    int i, j;
+
+    printf("grubbench\n");
+    for (i = 0; i < sizeof(sets) / sizeof(sets[0]); i++) {
+        for (j = 0; j < sizeof(policies) / sizeof(policies[0]); j++) {
+            // a child per run, so each policy starts with empty state
+            if (fork() == 0) {
+                run(policies[j], &sets[i]);
+                exit(0);
+            }
+            wait(0);
+        }
+    }
+    exit(0);
+}
@@ -0,0 +1,88 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/heap.h"
+
+static void __heap_set(struct heap *h, int i, void *item)
+{
+    h->items[i] = item;
+    if (h->moved)
+        h->moved(item, i);
+}
+
+static void __heap_up(struct heap *h, int i)
+{
+    void *item = h->items[i];
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!h->less(item, h->items[parent]))
+            break;
+        __heap_set(h, i, h->items[parent]);
+        i = parent;
+    }
+    __heap_set(h, i, item);
+}
+
+static void __heap_down(struct heap *h, int i)
+{
+    void *item = h->items[i];
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= h->size)
+            break;
+        if (child + 1 < h->size && h->less(h->items[child + 1], h->items[child]))
+            child++;
+        if (!h->less(h->items[child], item))
+            break;
+        __heap_set(h, i, h->items[child]);
+        i = child;
+    }
+    __heap_set(h, i, item);
+}
+
+// returns -1 if the array could not grow
+int heap_push(struct heap *h, void *item)
+{
+    if (h->size == h->cap) {
+        int cap = h->cap ? h->cap * 2 : 16;
+        void **items = (void **)malloc(cap * sizeof(void *));
+        if (items == 0)
+            return -1;
+        memmove(items, h->items, h->size * sizeof(void *));
+        if (h->items)
+            free(h->items);
+        h->items = items;
+        h->cap = cap;
+    }
+    h->items[h->size++] = item;
+    __heap_up(h, h->size - 1);
+    return 0;
+}
+
+void *heap_remove(struct heap *h, int index)
+{
+    void *item = h->items[index];
+    void *last = h->items[--h->size];
+    if (index < h->size) {
+        h->items[index] = last;
+        heap_fix(h, index);
+    }
+    if (h->moved)
+        h->moved(item, -1);
+    return item;
+}
+
+void *heap_pop(struct heap *h)
+{
+    if (h->size == 0)
+        return 0;
+    return heap_remove(h, 0);
+}
+
+// restore the order after the key of the item at index changed
+void heap_fix(struct heap *h, int index)
+{
+    if (index > 0 && h->less(h->items[index], h->items[(index - 1) / 2]))
+        __heap_up(h, index);
+    else
+        __heap_down(h, index);
+}
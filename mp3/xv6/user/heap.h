@@ -0,0 +1,26 @@
+#ifndef HEAP_H_
+#define HEAP_H_
+
+// Binary min-heap of pointers, ordered by less(a, b) != 0 meaning a comes
+// first. The array grows on demand. If moved is set it is told every
+// item's new slot (-1 once removed), so an item can later be removed or
+// re-keyed in O(log n) with heap_remove/heap_fix.
+struct heap {
+    void **items;
+    int size;
+    int cap;
+    int (*less)(void *a, void *b);
+    void (*moved)(void *item, int index);
+};
+
+#define HEAP_INIT(less, moved) { 0, 0, 0, less, moved }
+
+#define heap_empty(h) ((h)->size == 0)
+#define heap_top(h) ((h)->size ? (h)->items[0] : 0)
+
+int heap_push(struct heap *h, void *item);
+void *heap_pop(struct heap *h);
+void *heap_remove(struct heap *h, int index);
+void heap_fix(struct heap *h, int index);
+
+#endif // HEAP_H_
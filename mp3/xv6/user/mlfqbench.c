@@ -0,0 +1,167 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/list.h"
+#include "user/heap.h"
+#include "user/threads.h"
+#include "user/threads_sched.h"
+
+#define NULL 0
+#define TIME_QUANTUM 2
+
+// Response times of a mixed workload under RR and MLFQ. Interactive
+// threads run short bursts every few ticks, batch threads one long burst
+// whose length the policies are not told about up front. The threads are
+// simulated as in grubbench; both policies keep the CPU busy whenever
+// something is runnable, so the work finishes at the same time and the
+// throughput is the same. Times in ticks, averages per job:
+//   bench: mlfq.<policy> resp_avg=<t> interactive_avg=<t> interactive_max=<t> batch_avg=<t> makespan=<t>
+
+struct task {
+    int interactive;
+    int burst;
+    int period; // between releases of an interactive thread's bursts
+    int n;
+    int arrival;
+};
+
+static struct task tasks[] = {
+    { 1, 1, 6, 15, 0 },
+    { 1, 2, 10, 9, 1 },
+    { 1, 1, 8, 11, 3 },
+    { 0, 30, 0, 1, 0 },
+    { 0, 25, 0, 1, 0 },
+};
+
+#define NTASKS (sizeof(tasks) / sizeof(tasks[0]))
+
+struct acc {
+    int total;
+    int max;
+    int n;
+};
+
+static int release_before(void *a, void *b)
+{
+    struct release_queue_entry *x = a, *y = b;
+    if (x->release_time != y->release_time)
+        return x->release_time < y->release_time;
+    return x->seq < y->seq;
+}
+
+static void add(struct acc *a, int v)
+{
+    a->total += v;
+    if (v > a->max)
+        a->max = v;
+    a->n++;
+}
+
+// average in tenths of a tick
+static void print_avg(char *label, struct acc *a)
+{
+    int tenths = a->n ? a->total * 10 / a->n : 0;
+    printf(" %s_avg=%d.%d", label, tenths / 10, tenths % 10);
+}
+
+static void run(struct thread_sched_ops *ops)
+{
+    LIST_HEAD(run_queue);
+    struct heap release_queue = HEAP_INIT(release_before, NULL);
+    struct thread th[NTASKS];
+    struct release_queue_entry ent[NTASKS];
+    int released[NTASKS];
+    struct release_queue_entry *e;
+    struct threads_sched_result r;
+    struct acc all = { 0, 0, 0 }, interactive = { 0, 0, 0 }, batch = { 0, 0, 0 };
+    int now = 0, seq = 0, i;
+
+    memset(th, 0, sizeof(th));
+    for (i = 0; i < NTASKS; i++) {
+        th[i].ID = i + 1;
+        th[i].processing_time = tasks[i].burst;
+        th[i].period = tasks[i].period;
+        th[i].n = tasks[i].n;
+        th[i].arrival_time = tasks[i].arrival;
+        // one level for RR: equal priorities take turns
+        th[i].priority = 0;
+        ent[i].thrd = &th[i];
+        ent[i].release_time = tasks[i].arrival;
+        ent[i].seq = seq++;
+        heap_push(&release_queue, &ent[i]);
+    }
+
+    while (!list_empty(&run_queue) || !heap_empty(&release_queue)) {
+        while ((e = heap_top(&release_queue)) != NULL && now >= e->release_time) {
+            heap_pop(&release_queue);
+            e->thrd->remaining_time = e->thrd->processing_time;
+            released[e->thrd - th] = e->release_time;
+            list_add_tail(&e->thrd->thread_list, &run_queue);
+            if (ops->on_release)
+                ops->on_release(e->thrd);
+        }
+        struct threads_sched_args args = {
+            .time_quantum = TIME_QUANTUM,
+            .current_time = now,
+            .run_queue = &run_queue,
+            .release_queue = &release_queue,
+        };
+        r = ops->pick(args);
+        if (r.scheduled_thread_list_member == &run_queue) {
+            if (r.allocated_time > 0)
+                now += r.allocated_time;
+            else
+                now = ((struct release_queue_entry *)heap_top(&release_queue))->release_time;
+            continue;
+        }
+
+        struct thread *t = list_entry(r.scheduled_thread_list_member, struct thread, thread_list);
+        now += r.allocated_time;
+        t->remaining_time -= r.allocated_time;
+        if (ops->on_tick)
+            ops->on_tick(t, r.allocated_time);
+        list_del(&t->thread_list);
+        if (t->remaining_time > 0) {
+            list_add_tail(&t->thread_list, &run_queue);
+            continue;
+        }
+
+        i = t - th;
+        add(&all, now - released[i]);
+        add(tasks[i].interactive ? &interactive : &batch, now - released[i]);
+        if (ops->on_finish)
+            ops->on_finish(t);
+        if (--t->n > 0) {
+            e = &ent[i];
+            e->release_time = released[i] + t->period;
+            if (e->release_time < now)
+                e->release_time = now;
+            e->seq = seq++;
+            heap_push(&release_queue, e);
+        }
+    }
+
+    printf("bench: mlfq.%s", ops->name);
+    print_avg("resp", &all);
+    print_avg("interactive", &interactive);
+    printf(" interactive_max=%d", interactive.max);
+    print_avg("batch", &batch);
+    printf(" makespan=%d\n", now);
+    free(release_queue.items);
+}
+
+int main(int argc, char **argv)
+{
+    struct thread_sched_ops *policies[] = { &sched_priority_rr, &sched_mlfq };
+    int i;
+
+    printf("mlfqbench\n");
+    for (i = 0; i < sizeof(policies) / sizeof(policies[0]); i++) {
+        // a child per run, so each policy starts with empty state
+        if (fork() == 0) {
+            run(policies[i]);
+            exit(0);
+        }
+        wait(0);
+    }
+    exit(0);
+}
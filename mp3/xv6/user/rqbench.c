@@ -0,0 +1,90 @@
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+// Per-hart scheduler counters over two loads: two processes passing a
+// byte back and forth over pipes, every round a sleep and a wakeup, and
+// then twice as many CPU hogs as harts, spread over the harts by
+// stealing. Run with several harts, e.g. make CPUS=4 qemu. Times in
+// ticks:
+//   bench: rq.<load> ticks=<t>
+//   bench: rq.<load> hart<n> switches=<n> steals=<n>
+
+#define ROUNDS 2000
+#define HOG_TICKS 20
+
+static uint64 before[NCPU][2];
+
+static int snapshot(void)
+{
+    int h;
+    for (h = 0; h < NCPU && schedstat(h, before[h]) == 0; h++)
+        ;
+    return h;
+}
+
+static void report(char *load, int harts, int ticks)
+{
+    uint64 now[2];
+    int h;
+
+    printf("bench: rq.%s ticks=%d\n", load, ticks);
+    for (h = 0; h < harts; h++) {
+        schedstat(h, now);
+        printf("bench: rq.%s hart%d switches=%d steals=%d\n", load, h,
+               (int)(now[0] - before[h][0]), (int)(now[1] - before[h][1]));
+    }
+}
+
+static void pingpong(void)
+{
+    int ping[2], pong[2], i, start, harts;
+    char c = 0;
+
+    pipe(ping);
+    pipe(pong);
+    harts = snapshot();
+    start = uptime();
+    if (fork() == 0) {
+        for (i = 0; i < ROUNDS; i++) {
+            read(ping[0], &c, 1);
+            write(pong[1], &c, 1);
+        }
+        exit(0);
+    }
+    for (i = 0; i < ROUNDS; i++) {
+        write(ping[1], &c, 1);
+        read(pong[0], &c, 1);
+    }
+    wait(0);
+    report("pingpong", harts, uptime() - start);
+    close(ping[0]);
+    close(ping[1]);
+    close(pong[0]);
+    close(pong[1]);
+}
+
+static void hogs(void)
+{
+    int harts = snapshot(), start = uptime(), i;
+    volatile int k = 0;
+
+    for (i = 0; i < 2 * harts; i++) {
+        if (fork() == 0) {
+            while (uptime() < start + HOG_TICKS)
+                k++;
+            exit(0);
+        }
+    }
+    for (i = 0; i < 2 * harts; i++)
+        wait(0);
+    report("hogs", harts, uptime() - start);
+}
+
+int main(int argc, char **argv)
+{
+    printf("rqbench\n");
+    pingpong();
+    hogs();
+    exit(0);
+}
@@ -0,0 +1,302 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/rtanalysis.h"
+
+#define HORIZON_MAX 100000 // ticks: longer hyperperiods are cut here
+
+static uint64 __gcd(uint64 a, uint64 b)
+{
+    while (b) {
+        uint64 t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// lcm of the periods, HORIZON_MAX if it is larger
+static int __hyperperiod(struct rt_task *ts, int n)
+{
+    uint64 h = 1;
+    int i;
+    for (i = 0; i < n; i++) {
+        h = h / __gcd(h, ts[i].period) * ts[i].period;
+        if (h > HORIZON_MAX)
+            return HORIZON_MAX;
+    }
+    return h;
+}
+
+// a has the higher deadline-monotonic priority
+static int __dm_before(struct rt_task *a, struct rt_task *b)
+{
+    if (a->deadline != b->deadline)
+        return a->deadline < b->deadline;
+    return a->id < b->id;
+}
+
+int rta_dm(struct rt_task *ts, int n)
+{
+    int i, j, misses = 0;
+    for (i = 0; i < n; i++) {
+        // R = C_i + B_i + sum over higher priority j of ceil((R + J_j) / T_j) * C_j
+        int r = ts[i].wcet + ts[i].blocking, next;
+        for (;;) {
+            next = ts[i].wcet + ts[i].blocking;
+            for (j = 0; j < n; j++)
+                if (j != i && __dm_before(&ts[j], &ts[i]))
+                    next += (r + ts[j].jitter + ts[j].period - 1) / ts[j].period * ts[j].wcet;
+            if (next > ts[i].deadline) {
+                r = -1;
+                break;
+            }
+            if (next == r)
+                break;
+            r = next;
+        }
+        ts[i].response = r;
+        if (r < 0)
+            misses++;
+    }
+    return misses;
+}
+
+// what EDF reserves per period: a soft thread is throttled at its budget
+static int __edf_wcet(struct rt_task *t)
+{
+    return t->budget ? t->budget : t->wcet;
+}
+
+// sum of wcet/period <= 1, in 32-bit fixed point rounded up
+static int __utilization_fixed_ok(struct rt_task *ts, int n)
+{
+    uint64 u = 0;
+    int i;
+    for (i = 0; i < n; i++)
+        u += (((uint64)__edf_wcet(&ts[i]) << 32) + ts[i].period - 1) / ts[i].period;
+    return u <= (1UL << 32);
+}
+
+// sum of wcet/period <= 1, exactly while the common denominator fits
+static int __utilization_ok(struct rt_task *ts, int n)
+{
+    uint64 num = 0, den = 1, g;
+    int i;
+    for (i = 0; i < n; i++) {
+        if (den > 0xffffffffUL / ts[i].period)
+            return __utilization_fixed_ok(ts, n);
+        num = num * ts[i].period + __edf_wcet(&ts[i]) * den;
+        den *= ts[i].period;
+        g = __gcd(num, den);
+        num /= g;
+        den /= g;
+    }
+    return num <= den;
+}
+
+// jobs with deadlines in [0, t] never need more than t ticks
+static int __demand_ok(struct rt_task *ts, int n, int horizon)
+{
+    int i, j, k, t;
+    for (i = 0; i < n; i++) {
+        for (k = 0; (t = k * ts[i].period + ts[i].deadline) <= horizon; k++) {
+            int demand = 0;
+            for (j = 0; j < n; j++)
+                if (t >= ts[j].deadline)
+                    demand += ((t - ts[j].deadline) / ts[j].period + 1) * __edf_wcet(&ts[j]);
+            if (demand > t)
+                return 0;
+        }
+    }
+    return 1;
+}
+
+// EDF from a synchronous release, event by event: the running job keeps
+// the processor until it completes or the next release. A job still
+// running when its next one is released, or past its deadline, marks the
+// task -1
+static void __edf_responses(struct rt_task *ts, int n, int horizon)
+{
+    int *left = malloc(n * sizeof(int));
+    int *release = malloc(n * sizeof(int));
+    int i, t, run, next, end;
+
+    for (i = 0; i < n; i++) {
+        left[i] = 0;
+        release[i] = -ts[i].period; // so the first is at 0
+        ts[i].response = 0;
+    }
+    for (t = 0; t < horizon; t = end) {
+        next = horizon;
+        for (i = 0; i < n; i++) {
+            if (t == release[i] + ts[i].period) {
+                if (left[i] > 0)
+                    ts[i].response = -1;
+                left[i] = __edf_wcet(&ts[i]);
+                release[i] = t;
+            }
+            if (release[i] + ts[i].period < next)
+                next = release[i] + ts[i].period;
+        }
+        run = -1;
+        for (i = 0; i < n; i++) {
+            if (left[i] == 0)
+                continue;
+            if (run < 0 || release[i] + ts[i].deadline < release[run] + ts[run].deadline ||
+                (release[i] + ts[i].deadline == release[run] + ts[run].deadline && ts[i].id < ts[run].id))
+                run = i;
+        }
+        end = next;
+        if (run < 0)
+            continue;
+        if (t + left[run] < end)
+            end = t + left[run];
+        left[run] -= end - t;
+        if (left[run] == 0 && ts[run].response >= 0) {
+            int r = end - release[run];
+            if (r > ts[run].deadline)
+                ts[run].response = -1;
+            else if (r > ts[run].response)
+                ts[run].response = r;
+        }
+    }
+    for (i = 0; i < n; i++)
+        if (left[i] > 0 && t - release[i] >= ts[i].deadline)
+            ts[i].response = -1;
+    free(left);
+    free(release);
+}
+
+int edf_feasible(struct rt_task *ts, int n)
+{
+    int i, constrained = 0, horizon = __hyperperiod(ts, n);
+    int ok = __utilization_ok(ts, n);
+
+    for (i = 0; i < n; i++)
+        if (ts[i].deadline < ts[i].period)
+            constrained = 1;
+    if (ok && constrained)
+        ok = __demand_ok(ts, n, horizon);
+    __edf_responses(ts, n, horizon);
+    return ok;
+}
+
+int edf_vd_scale(uint64 lo, uint64 hi_lo, uint64 hi_hi)
+{
+    uint64 x;
+
+    if (lo + hi_hi <= VD_ONE)
+        return VD_ONE;
+    if (lo + hi_lo > VD_ONE || hi_hi > VD_ONE)
+        return -1;
+    // x = hi_lo / (1 - lo), rounded up; high mode needs x * lo + hi_hi <= 1
+    x = (hi_lo * VD_ONE + VD_ONE - lo - 1) / (VD_ONE - lo);
+    if (x * lo > (VD_ONE - hi_hi) * VD_ONE)
+        return -1;
+    return x;
+}
+
+// c / d in 1/VD_ONE, rounded up
+static uint64 __vd_density(int c, int d)
+{
+    return ((uint64)c * VD_ONE + d - 1) / d;
+}
+
+int edf_vd_feasible(struct rt_task *ts, int n)
+{
+    uint64 lo = 0, hi_lo = 0, hi_hi = 0;
+    int i, ok;
+
+    for (i = 0; i < n; i++) {
+        if (ts[i].wcet_hi) {
+            hi_lo += __vd_density(__edf_wcet(&ts[i]), ts[i].deadline);
+            hi_hi += __vd_density(ts[i].wcet_hi, ts[i].deadline);
+        } else {
+            lo += __vd_density(__edf_wcet(&ts[i]), ts[i].deadline);
+        }
+    }
+    ok = edf_vd_scale(lo, hi_lo, hi_hi) > 0;
+    for (i = 0; i < n; i++)
+        ts[i].response = ok ? ts[i].deadline : -1;
+    return ok;
+}
+
+// a uses more of a processor than b (lower id on ties)
+static int __heavier(struct rt_task *a, struct rt_task *b)
+{
+    uint64 x = (uint64)__edf_wcet(a) * b->period;
+    uint64 y = (uint64)__edf_wcet(b) * a->period;
+    if (x != y)
+        return x > y;
+    return a->id < b->id;
+}
+
+// copy the tasks on hart into bin, their indices into idx
+static int __bin(struct rt_task *ts, int n, int *part, int hart, struct rt_task *bin, int *idx)
+{
+    int i, m = 0;
+    for (i = 0; i < n; i++)
+        if (part[i] == hart) {
+            idx[m] = i;
+            bin[m++] = ts[i];
+        }
+    return m;
+}
+
+static int __fits(struct rt_task *bin, int m, int (*fits)(struct rt_task *ts, int n))
+{
+    return fits ? fits(bin, m) : __utilization_ok(bin, m);
+}
+
+int rta_partition(struct rt_task *ts, int n, int harts, int *part,
+                  int (*fits)(struct rt_task *ts, int n))
+{
+    struct rt_task *bin = malloc(n * sizeof(struct rt_task));
+    int *order = malloc(n * sizeof(int));
+    int *idx = malloc(n * sizeof(int));
+    int i, j, k, h, m, unplaced = 0;
+
+    for (i = 0; i < n; i++) {
+        part[i] = -1;
+        ts[i].response = -1;
+        for (j = i; j > 0 && __heavier(&ts[i], &ts[order[j - 1]]); j--)
+            order[j] = order[j - 1];
+        order[j] = i;
+    }
+
+    for (k = 0; k < n; k++) {
+        i = order[k];
+        for (h = 0; h < harts && part[i] < 0; h++) {
+            m = __bin(ts, n, part, h, bin, idx);
+            bin[m++] = ts[i];
+            if (__fits(bin, m, fits))
+                part[i] = h;
+        }
+        if (part[i] < 0)
+            unplaced++;
+    }
+
+    for (h = 0; h < harts; h++) {
+        m = __bin(ts, n, part, h, bin, idx);
+        if (m == 0)
+            continue;
+        __fits(bin, m, fits);
+        for (j = 0; j < m; j++)
+            ts[idx[j]].response = bin[j].response;
+    }
+
+    free(bin);
+    free(order);
+    free(idx);
+    return unplaced;
+}
+
+int rta_load(struct rt_task *ts, int n, int *part, int hart)
+{
+    uint64 load = 0;
+    int i;
+    for (i = 0; i < n; i++)
+        if (part == 0 || part[i] == hart)
+            load += ((uint64)__edf_wcet(&ts[i]) * 1000 + ts[i].period - 1) / ts[i].period;
+    return load;
+}
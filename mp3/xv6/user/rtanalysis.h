@@ -0,0 +1,57 @@
+#ifndef RTANALYSIS_H_
+#define RTANALYSIS_H_
+
+// Schedulability analysis for periodic real-time threads, shared by
+// admission control in threads.c and the rtanalyze tool. Times in ticks.
+struct rt_task {
+    int id;
+    int wcet;     // worst-case execution per period
+    int wcet_hi;  // EDF_VD: pessimistic wcet of a high-criticality task, 0 for a low one
+    int budget;   // CBS budget of a soft thread, 0 for a hard one
+    int period;
+    int deadline; // relative deadline
+    int blocking; // longest wait on lower-priority threads holding a mutex
+    int jitter;   // latest a job can start being demanded after its release
+    int response; // set by the analysis: worst-case response time, -1 if it can exceed deadline
+};
+
+// response-time analysis under deadline-monotonic priorities (shorter
+// deadline first, lower id on ties), each task also waiting out its
+// blocking and a higher-priority task's jitter letting more of its jobs
+// in; returns the number of tasks that can miss their deadline
+int rta_dm(struct rt_task *ts, int n);
+
+// EDF feasibility (utilization test, processor-demand test when some
+// deadline is shorter than its period), soft threads counting with their
+// CBS budget; returns 1 if schedulable.
+// response is the worst response seen in an EDF run from a synchronous
+// release over one hyperperiod.
+int edf_feasible(struct rt_task *ts, int n);
+
+// EDF with virtual deadlines for mixed criticality: tasks with wcet_hi
+// run with wcet until one overruns it, then the others are dropped and
+// they may take wcet_hi. Given utilizations in 1/VD_ONE of the low
+// tasks, and of the high ones at wcet and at wcet_hi, returns the
+// factor in 1/VD_ONE that scales the high tasks' deadlines while none
+// has overrun, VD_ONE if plain EDF already fits the worst case, or -1 if
+// no factor keeps both modes schedulable (Baruah et al.)
+#define VD_ONE (1 << 20)
+int edf_vd_scale(uint64 lo, uint64 hi_lo, uint64 hi_hi);
+
+// the EDF_VD test on implicit or constrained deadlines (densities);
+// response is the deadline of every task if it passes, -1 if not
+int edf_vd_feasible(struct rt_task *ts, int n);
+
+// first-fit decreasing: tasks in order of falling utilization go to the
+// first of `harts` processors whose set still passes fits (the
+// utilization bound if NULL). part[i] gets task i's processor, -1 if it
+// fits nowhere, and response its result there (-1 under the bound);
+// returns the number of tasks left out
+int rta_partition(struct rt_task *ts, int n, int harts, int *part,
+                  int (*fits)(struct rt_task *ts, int n));
+
+// utilization of the tasks on hart (all tasks if part is NULL), in
+// thousandths rounded up
+int rta_load(struct rt_task *ts, int n, int *part, int hart);
+
+#endif // RTANALYSIS_H_
@@ -0,0 +1,105 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/rtanalysis.h"
+
+// Offline schedulability check of a periodic task set, with the same
+// analysis as admission control in threads.c. Each task is C,T[,D[,B]]
+// (D defaults to T, B, the blocking on mutexes of lower-priority threads
+// that DM adds to the response, to 0); for EDF_CBS a leading 's' marks a
+// soft thread whose C is its CBS budget. Tasks are numbered from 1 in
+// argument order.
+// With -p N the set is partitioned first-fit decreasing over N harts,
+// as thread_start_partitioned() does, and each hart is analysed alone.
+//   rtanalyze DM 3,9 5,15 3,9
+//   rtanalyze DM 2,8,8,3 4,16 4,20
+//   rtanalyze EDF_CBS 15,20 s10,15
+//   rtanalyze -p 2 DM 3,5 3,5 2,10
+
+static char *__field(char *s, int *v)
+{
+    *v = atoi(s);
+    while (*s >= '0' && *s <= '9')
+        s++;
+    return *s == ',' ? s + 1 : 0;
+}
+
+static int __dm_fits(struct rt_task *ts, int n)
+{
+    return rta_dm(ts, n) == 0;
+}
+
+// load in thousandths as a decimal
+static void __print_load(int load)
+{
+    printf("%d.%d%d%d", load / 1000, load / 100 % 10, load / 10 % 10, load % 10);
+}
+
+int main(int argc, char **argv)
+{
+    struct rt_task *ts;
+    int *part = 0;
+    int n, i, h, bad, edf, harts = 0;
+
+    if (argc > 2 && strcmp(argv[1], "-p") == 0) {
+        harts = atoi(argv[2]);
+        argc -= 2;
+        argv += 2;
+    }
+    n = argc - 2;
+    if (argc < 3 || harts < 0 || (strcmp(argv[1], "DM") != 0 && strcmp(argv[1], "EDF_CBS") != 0)) {
+        fprintf(2, "Usage: rtanalyze [-p harts] DM|EDF_CBS C,T[,D[,B]] ...\n");
+        exit(1);
+    }
+    edf = strcmp(argv[1], "EDF_CBS") == 0;
+
+    ts = (struct rt_task *)malloc(n * sizeof(struct rt_task));
+    for (i = 0; i < n; i++) {
+        char *s = argv[i + 2];
+        int soft = edf && *s == 's';
+        if (soft)
+            s++;
+        ts[i].id = i + 1;
+        s = __field(s, &ts[i].wcet);
+        ts[i].budget = soft ? ts[i].wcet : 0;
+        if (s == 0 || (s = __field(s, &ts[i].period), ts[i].period <= 0)) {
+            fprintf(2, "rtanalyze: bad task %s\n", argv[i + 2]);
+            exit(1);
+        }
+        ts[i].deadline = ts[i].period;
+        ts[i].blocking = 0;
+        ts[i].jitter = 0;
+        ts[i].wcet_hi = 0;
+        if (s != 0 && (s = __field(s, &ts[i].deadline)) != 0)
+            __field(s, &ts[i].blocking);
+    }
+
+    if (harts > 0) {
+        part = (int *)malloc(n * sizeof(int));
+        bad = rta_partition(ts, n, harts, part, edf ? edf_feasible : __dm_fits);
+    } else if (edf)
+        bad = !edf_feasible(ts, n);
+    else
+        bad = rta_dm(ts, n);
+
+    for (i = 0; i < n; i++) {
+        printf("thread#%d: C=%d T=%d D=%d ", ts[i].id, ts[i].wcet, ts[i].period, ts[i].deadline);
+        if (ts[i].blocking)
+            printf("B=%d ", ts[i].blocking);
+        if (ts[i].response < 0)
+            printf("R>D");
+        else
+            printf("R=%d", ts[i].response);
+        if (part && part[i] < 0)
+            printf(" hart#none");
+        else if (part)
+            printf(" hart#%d", part[i]);
+        printf("\n");
+    }
+    for (h = 0; h < harts; h++) {
+        printf("hart#%d: U=", h);
+        __print_load(rta_load(ts, n, part, h));
+        printf("\n");
+    }
+    printf("%s\n", bad ? "not schedulable" : "schedulable");
+    exit(0);
+}
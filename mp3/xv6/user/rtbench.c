@@ -0,0 +1,146 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/list.h"
+#include "user/heap.h"
+#include "user/threads.h"
+#include "user/threads_sched.h"
+
+#define NULL 0
+#define STEPS 2000
+#define TIME_QUANTUM 2
+
+// Scheduler overhead with many periodic threads: every step releases the
+// due threads from the release heap and asks a policy for a decision, as
+// __release() and __schedule() do. Every policy is measured in turn. The threads are
+// simulated, not run, so only the policy is timed.
+// Times are rdtime cycles (10MHz under qemu), one line per thread count:
+//   bench: <name>.<policy> threads=<n> ops=<count> avg=<cycles> min=<cycles> max=<cycles>
+// schedule: staggered arrivals, the run queue stays short.
+// backlog: every thread arrives at 0, the run queue starts n long.
+
+static int counts[] = { 16, 64, 256, 512 };
+
+struct acc {
+    uint64 total;
+    uint64 min;
+    uint64 max;
+    int n;
+};
+
+static inline uint64 rdtime(void)
+{
+    uint64 t;
+    asm volatile("rdtime %0" : "=r"(t));
+    return t;
+}
+
+static int release_before(void *a, void *b)
+{
+    struct release_queue_entry *x = a, *y = b;
+    if (x->release_time != y->release_time)
+        return x->release_time < y->release_time;
+    return x->seq < y->seq;
+}
+
+// n threads of 1 tick each, with periods spread over [2n, 3n), arriving
+// at their index if stagger is set, else all at 0
+static void bench(struct thread_sched_ops *ops, char *name, int n, int stagger)
+{
+    LIST_HEAD(run_queue);
+    struct heap release_queue = HEAP_INIT(release_before, NULL);
+    struct thread *th = (struct thread *)malloc(n * sizeof(struct thread));
+    struct release_queue_entry *ent = malloc(n * sizeof(struct release_queue_entry));
+    struct release_queue_entry *e;
+    struct threads_sched_result r;
+    struct acc a = { 0, ~0UL, 0, 0 };
+    int now = 0, seq = 0, i, step;
+    uint64 t0, dt;
+
+    memset(th, 0, n * sizeof(struct thread));
+    for (i = 0; i < n; i++) {
+        th[i].ID = i + 1;
+        th[i].is_real_time = 1;
+        th[i].processing_time = 1;
+        th[i].period = th[i].deadline = th[i].effective_period = 2 * n + i;
+        th[i].priority = i % 16;
+        th[i].arrival_time = stagger ? i : 0;
+        th[i].cbs.is_hard_rt = 1;
+        th[i].mc.wcet_lo = th[i].mc.wcet_hi = 1;
+        ent[i].thrd = &th[i];
+        ent[i].release_time = th[i].arrival_time;
+        ent[i].seq = seq++;
+        heap_push(&release_queue, &ent[i]);
+    }
+
+    for (step = 0; step < STEPS; step++) {
+        t0 = rdtime();
+        while ((e = heap_top(&release_queue)) != NULL && now >= e->release_time) {
+            heap_pop(&release_queue);
+            e->thrd->remaining_time = e->thrd->processing_time;
+            e->thrd->current_deadline = e->release_time + e->thrd->deadline;
+            list_add_tail(&e->thrd->thread_list, &run_queue);
+            if (ops->on_release)
+                ops->on_release(e->thrd);
+        }
+        struct threads_sched_args args = {
+            .time_quantum = TIME_QUANTUM,
+            .current_time = now,
+            .run_queue = &run_queue,
+            .release_queue = &release_queue,
+        };
+        r = ops->pick(args);
+        dt = rdtime() - t0;
+        a.total += dt;
+        if (dt < a.min)
+            a.min = dt;
+        if (dt > a.max)
+            a.max = dt;
+        a.n++;
+
+        if (r.scheduled_thread_list_member == &run_queue) {
+            now += r.allocated_time > 0 ? r.allocated_time : 1;
+            continue;
+        }
+        // run it; a thread that would miss its deadline is just retired
+        // for this period
+        struct thread *t = list_entry(r.scheduled_thread_list_member, struct thread, thread_list);
+        int run = r.allocated_time > 0 ? r.allocated_time : 0;
+        now += run;
+        t->remaining_time -= run;
+        if (t->remaining_time <= 0 || run == 0) {
+            list_del(&t->thread_list);
+            if (ops->on_finish)
+                ops->on_finish(t);
+            e = &ent[t - th];
+            e->release_time = t->current_deadline;
+            e->seq = seq++;
+            heap_push(&release_queue, e);
+        }
+    }
+
+    printf("bench: %s.%s threads=%d ops=%d avg=%d min=%d max=%d\n",
+           name, ops->name, n, a.n, (int)(a.total / a.n), (int)a.min, (int)a.max);
+    while (!list_empty(&run_queue)) {
+        struct thread *t = list_entry(run_queue.next, struct thread, thread_list);
+        list_del(&t->thread_list);
+        if (ops->on_finish)
+            ops->on_finish(t);
+    }
+    free(release_queue.items);
+    free(ent);
+    free(th);
+}
+
+int main(int argc, char **argv)
+{
+    struct thread_sched_ops **ops;
+    int i;
+    printf("rtbench\n");
+    for (ops = thread_schedulers; *ops != NULL; ops++) {
+        for (i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+            bench(*ops, "schedule", counts[i], 1);
+        for (i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+            bench(*ops, "backlog", counts[i], 0);
+    }
+    exit(0);
+}
@@ -0,0 +1,51 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/threads.h"
+
+#define NULL 0
+
+int k = 0;
+
+void f(void *arg)
+{
+    while (1) {
+        k++;
+    }
+}
+
+// Two periodic threads (U=0.6) and an aperiodic thread whose 2-tick jobs
+// arrive at 3 and 14. In the background it waits for the periodic work
+// to be done; under a server of budget 2 every 10 ticks, which still
+// leaves the periodic threads schedulable, it runs as soon as it arrives.
+int main(int argc, char **argv)
+{
+    struct thread_server s;
+    int type = -1;
+
+    if (argc < 2 || strcmp(argv[1], "DM") != 0) {
+        fprintf(2, "Usage: rttask10 DM [sporadic|deferrable]\n");
+        exit(1);
+    }
+    if (argc > 2)
+        type = strcmp(argv[2], "deferrable") == 0 ? SERVER_DEFERRABLE : SERVER_SPORADIC;
+    thread_set_admission(ADMIT_REJECT);
+    if (type >= 0)
+        thread_server_init(&s, type, 2, 10);
+
+    struct thread *t1 = thread_create(f, NULL, 1, 2, 5, 4);
+    if (thread_add_at(t1, 0) < 0)
+        exit(1);
+
+    struct thread *t2 = thread_create(f, NULL, 1, 4, 20, 1);
+    if (thread_add_at(t2, 0) < 0)
+        exit(1);
+
+    struct thread *t3 = thread_create(f, NULL, 0, 2, 11, 2);
+    if (type >= 0)
+        thread_serve(t3, &s);
+    thread_add_at(t3, 3);
+
+    thread_start_threading();
+    printf("\nexited\n");
+    exit(0);
+}
@@ -0,0 +1,47 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/threads.h"
+
+#define NULL 0
+
+int k = 0;
+
+void f(void *arg)
+{
+    while (1) {
+        k++;
+    }
+}
+
+// A high-criticality thread trusted with 1 tick per 10 that may need 4,
+// and two low-criticality threads (U=0.7). Sized for the worst case the
+// set needs 1.1 of the CPU; EDF-VD admits it by running the high thread
+// to a virtual deadline of 4. With "overrun" every high job takes all 4
+// ticks: the low jobs in the way are dropped and the high ones still
+// finish in time.
+int main(int argc, char **argv)
+{
+    if (argc < 2 || strcmp(argv[1], "EDF_VD") != 0) {
+        fprintf(2, "Usage: rttask11 EDF_VD [overrun]\n");
+        exit(1);
+    }
+    int overrun = argc > 2 && strcmp(argv[2], "overrun") == 0;
+    thread_set_admission(ADMIT_REJECT);
+
+    struct thread *t1 = thread_create(f, NULL, 1, overrun ? 4 : 1, 10, 2);
+    thread_set_criticality(t1, CRIT_HI, 1, 4);
+    if (thread_add_at(t1, 0) < 0)
+        exit(1);
+
+    struct thread *t2 = thread_create(f, NULL, 1, 3, 6, 3);
+    if (thread_add_at(t2, 0) < 0)
+        exit(1);
+
+    struct thread *t3 = thread_create(f, NULL, 1, 1, 5, 4);
+    if (thread_add_at(t3, 0) < 0)
+        exit(1);
+
+    thread_start_threading();
+    printf("\nexited\n");
+    exit(0);
+}
@@ -0,0 +1,45 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/threads.h"
+
+#define NULL 0
+
+int k = 0;
+
+void f(void *arg)
+{
+    while (1) {
+        k++;
+    }
+}
+
+// a set with utilization 1.4, split over two harts; needs CPUS=2
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(2, "Usage: rttask7 [EDF_CBS|DM]\n");
+        exit(1);
+    }
+
+    struct thread *t1 = thread_create(f, NULL, 1, 3, 5, 2);
+    struct thread *t2 = thread_create(f, NULL, 1, 3, 5, 2);
+    struct thread *t3 = thread_create(f, NULL, 1, 2, 10, 1);
+
+    if (strcmp(argv[1], "EDF_CBS") == 0) {
+        init_thread_cbs(t1, 3, 1);
+        init_thread_cbs(t2, 3, 1);
+        init_thread_cbs(t3, 2, 1);
+    } else if (strcmp(argv[1], "DM") != 0) {
+        fprintf(2, "Unknown mode: %s\n", argv[1]);
+        exit(1);
+    }
+    thread_add_at(t1, 0);
+    thread_add_at(t2, 0);
+    thread_add_at(t3, 0);
+
+    if (thread_start_partitioned(2) < 0)
+        printf("\nnot partitioned\n");
+    else
+        printf("\nexited\n");
+    exit(0);
+}
@@ -0,0 +1,56 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/threads.h"
+#include "user/trace.h"
+
+#define NULL 0
+
+int k = 0;
+
+void f(void *arg)
+{
+    while (1) {
+        k++;
+    }
+}
+
+// a traced run: the log goes through rttrace.py on the host
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(2, "Usage: rttask8 [EDF_CBS|DM]\n");
+        exit(1);
+    }
+
+    if (strcmp(argv[1], "EDF_CBS") == 0) {
+        struct thread *t1 = thread_create(f, NULL, 1, 7, 22, 2);
+        init_thread_cbs(t1, 7, 1);
+        thread_add_at(t1, 0);
+
+        struct thread *t2 = thread_create(f, NULL, 1, 8, 10, 2);
+        init_thread_cbs(t2, 5, 0);
+        thread_add_at(t2, 0);
+
+    } else if (strcmp(argv[1], "DM") == 0) {
+        struct thread *t1 = thread_create(f, NULL, 1, 1, 10, 2);
+        thread_add_at(t1, 3);
+
+        struct thread *t2 = thread_create(f, NULL, 1, 2, 10, 2);
+        thread_add_at(t2, 2);
+
+        struct thread *t3 = thread_create(f, NULL, 1, 3, 10, 2);
+        thread_add_at(t3, 1);
+
+        struct thread *t4 = thread_create(f, NULL, 1, 4, 10, 2);
+        thread_add_at(t4, 0);
+
+    } else {
+        fprintf(2, "Unknown mode: %s\n", argv[1]);
+        exit(1);
+    }
+
+    trace_start();
+    thread_start_threading();
+    printf("\nexited\n");
+    exit(0);
+}
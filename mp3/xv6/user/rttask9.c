@@ -0,0 +1,46 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/threads.h"
+
+#define NULL 0
+
+int k = 0;
+
+void f(void *arg)
+{
+    while (1) {
+        k++;
+    }
+}
+
+// Thread#1 holds the mutex for the first 3 ticks of its job when thread#3
+// needs it. Thread#2, of middle priority, is released meanwhile but cannot
+// run before thread#1 is out of the critical section, so thread#3 waits at
+// most that one section, the blocking the analysis charges it.
+int main(int argc, char **argv)
+{
+    struct thread_mutex m;
+
+    if (argc < 2 || strcmp(argv[1], "DM") != 0) {
+        fprintf(2, "Usage: rttask9 DM [ceiling]\n");
+        exit(1);
+    }
+    thread_mutex_init(&m, argc > 2 && strcmp(argv[2], "ceiling") == 0 ? MUTEX_CEILING : MUTEX_INHERIT, 0);
+    thread_set_admission(ADMIT_REJECT);
+
+    struct thread *t1 = thread_create(f, NULL, 1, 4, 20, 1);
+    thread_critical(t1, &m, 0, 3);
+    thread_add_at(t1, 0);
+
+    struct thread *t2 = thread_create(f, NULL, 1, 4, 16, 1);
+    thread_add_at(t2, 2);
+
+    struct thread *t3 = thread_create(f, NULL, 1, 2, 8, 2);
+    thread_critical(t3, &m, 0, 1);
+    if (thread_add_at(t3, 1) < 0)
+        exit(1);
+
+    thread_start_threading();
+    printf("\nexited\n");
+    exit(0);
+}
@@ -0,0 +1,86 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/threads.h"
+#include "user/threads_sched.h"
+
+#define NULL 0
+
+// Runs one periodic task set under every policy, back to back, switching
+// with thread_set_scheduler(). The set fits any work-conserving order
+// (the sum of C is below the shortest period), so no policy misses a
+// deadline. Each policy's pick() is timed with rdtime, in 10MHz cycles:
+//   bench: pick.<policy> threads=<n> ops=<decisions> avg=<cycles> min=<cycles> max=<cycles>
+
+#define NTHREADS 4
+
+static int task_set[NTHREADS][3] = {
+    // processing_time, period, n
+    { 1, 10, 2 },
+    { 1, 12, 2 },
+    { 1, 14, 2 },
+    { 2, 16, 2 },
+};
+
+static struct thread_sched_ops *inner;
+static struct thread_sched_ops timed;
+static uint64 total, min, max;
+static int decisions;
+
+static inline uint64 rdtime(void)
+{
+    uint64 t;
+    asm volatile("rdtime %0" : "=r"(t));
+    return t;
+}
+
+static struct threads_sched_result timed_pick(struct threads_sched_args args)
+{
+    uint64 t0 = rdtime();
+    struct threads_sched_result r = inner->pick(args);
+    uint64 dt = rdtime() - t0;
+    total += dt;
+    if (dt < min)
+        min = dt;
+    if (dt > max)
+        max = dt;
+    decisions++;
+    return r;
+}
+
+int k = 0;
+
+void f(void *arg)
+{
+    while (1) {
+        k++;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    struct thread_sched_ops **ops;
+    int i;
+
+    printf("schedbench\n");
+    for (ops = thread_schedulers; *ops != NULL; ops++) {
+        inner = *ops;
+        timed = **ops;
+        timed.pick = timed_pick;
+        total = max = 0;
+        min = ~0UL;
+        decisions = 0;
+        if (thread_set_scheduler(&timed) < 0) {
+            fprintf(2, "schedbench: cannot switch to %s\n", inner->name);
+            exit(1);
+        }
+        for (i = 0; i < NTHREADS; i++) {
+            struct thread *t = thread_create(f, NULL, 1, task_set[i][0], task_set[i][1], task_set[i][2]);
+            thread_set_priority(t, i);
+            thread_add_at(t, i);
+        }
+        thread_start_threading();
+        printf("bench: pick.%s threads=%d ops=%d avg=%d min=%d max=%d\n",
+               inner->name, NTHREADS, decisions, (int)(total / decisions), (int)min, (int)max);
+    }
+    exit(0);
+}
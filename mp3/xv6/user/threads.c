@@ -3,18 +3,66 @@
 #include "user/threads_sched.h"
 #include "user/user.h"
 #include "user/list.h"
+#include "user/heap.h"
+#include "user/rtanalysis.h"
+#include "user/trace.h"
 
 #define NULL 0
 #define TIME_QUANTUM 2
 
+static int __release_before(void *a, void *b);
+
 static LIST_HEAD(run_queue);
-static LIST_HEAD(release_queue);
+static struct heap release_queue = HEAP_INIT(__release_before, NULL);
+static int release_seq = 0;
+static LIST_HEAD(rt_threads);
+static LIST_HEAD(servers);
+// exited threads, through thread_list: the stack freed with one may be
+// the stack still in use, so they are freed once the runtime is back on
+// another, by __reap()
+static LIST_HEAD(zombies);
+static int admission = ADMIT_OFF;
+
+// SCHEDPOLICY picks the policy threading starts with
+#if defined(THREAD_SCHEDULER_HRRN)
+static struct thread_sched_ops *sched = &sched_hrrn;
+#elif defined(THREAD_SCHEDULER_PRIORITY_RR)
+static struct thread_sched_ops *sched = &sched_priority_rr;
+#elif defined(THREAD_SCHEDULER_MLFQ)
+static struct thread_sched_ops *sched = &sched_mlfq;
+#elif defined(THREAD_SCHEDULER_EDF_CBS)
+static struct thread_sched_ops *sched = &sched_edf_cbs;
+#elif defined(THREAD_SCHEDULER_EDF_GRUB)
+static struct thread_sched_ops *sched = &sched_edf_grub;
+#elif defined(THREAD_SCHEDULER_EDF_VD)
+static struct thread_sched_ops *sched = &sched_edf_vd;
+#elif defined(THREAD_SCHEDULER_DM)
+static struct thread_sched_ops *sched = &sched_dm;
+#else
+static struct thread_sched_ops *sched = &sched_default;
+#endif
 
 static struct list_head *current = NULL;
 static int threading_system_time = 0;
 static int main_thrd_id = -1;
+static jmp_buf main_env;
 static int sleeping = 0;
 static uint64 allocated_time = 0;
+static int tls_keys = 0;
+static int time_unit_us = 0;
+
+// CPU time is split at every switch: the cycles run since cycle_mark go
+// to the thread that ran, to idle waiting for a release, or to the
+// runtime itself (switch_handler, __release, the policy and the
+// syscalls around them). Threads that exit leave their totals in usage.
+struct thread_usage {
+    int ID;
+    int ran;
+    uint64 cycles;
+    struct thread_usage *next;
+};
+static uint64 cycle_mark, overhead_cycles, idle_cycles;
+static struct thread_usage *usage = NULL, **usage_tail = &usage;
 
 void __dispatch(void);
 void __schedule(void);
@@ -31,6 +79,7 @@ struct thread *thread_create(void (*f)(void *), void *arg, int is_real_time, int
     t->arg = arg;
     t->ID = _id++;
     t->buf_set = 0;
+    t->user_ctx = 0;
     t->stack = (void *)new_stack;
     t->stack_p = (void *)new_stack_p;
 
@@ -43,10 +92,84 @@ struct thread *thread_create(void (*f)(void *), void *arg, int is_real_time, int
     t->current_deadline = 0;
     t->priority = 100;
     t->arrival_time = 30000;
+    // hard until init_thread_cbs() says otherwise
+    t->cbs.budget = processing_time;
+    t->cbs.remaining_budget = processing_time;
+    t->cbs.is_hard_rt = 1;
+    t->cbs.is_throttled = 0;
+    t->cbs.throttled_arrived_time = 0;
+    t->cbs.throttle_new_deadline = 0;
+    t->cbs.spent = 0;
+    t->mlfq.level = 0;
+    t->mlfq.used = 0;
+    t->mlfq.epoch = 0;
+    // low criticality until thread_set_criticality() says otherwise
+    t->mc.level = CRIT_LO;
+    t->mc.wcet_lo = processing_time;
+    t->mc.wcet_hi = processing_time;
+    t->mc.executed = 0;
+    t->mc.counted = 0;
+    t->mc.dropped = 0;
+    t->rq_index = -1;
+    t->dl_index = -1;
+    INIT_LIST_HEAD(&t->rt_list);
+    t->effective_period = period;
+    INIT_LIST_HEAD(&t->held);
+    t->blocked_on = NULL;
+    t->want = NULL;
+    t->ncritical = 0;
+    t->server = NULL;
+    INIT_LIST_HEAD(&t->server_list);
+    t->hart = 0;
+    t->ran = 0;
+    t->cycles = 0;
+    memset(t->tls, 0, sizeof(t->tls));
+    t->arena = arena_create(THREAD_ARENA_SIZE);
     
     return t;
 }
 
+// point tp and the small-object allocator at t, or at nothing for main
+static void __switch_tls(struct thread *t)
+{
+    void **tls = t ? t->tls : NULL;
+    asm volatile("mv tp, %0"
+                 :
+                 : "r"(tls));
+    malloc_arena = t ? t->arena : NULL;
+}
+
+static void **__tls(void)
+{
+    void **tls;
+    asm volatile("mv %0, tp"
+                 : "=r"(tls));
+    return tls;
+}
+
+// returns a key valid in every thread, or -1 if all are taken
+int thread_key_create(void)
+{
+    if (tls_keys >= THREAD_KEYS_MAX)
+        return -1;
+    return tls_keys++;
+}
+
+void thread_setspecific(int key, void *value)
+{
+    void **tls = __tls();
+    if (tls != NULL && key >= 0 && key < tls_keys)
+        tls[key] = value;
+}
+
+void *thread_getspecific(int key)
+{
+    void **tls = __tls();
+    if (tls == NULL || key < 0 || key >= tls_keys)
+        return NULL;
+    return tls[key];
+}
+
 void thread_set_priority(struct thread *t, int priority)
 {
     t->priority = priority;
@@ -59,45 +182,486 @@ void init_thread_cbs(struct thread *t, int budget, int is_hard_rt)
     t->cbs.is_throttled = 0;
     t->cbs.throttled_arrived_time = 0;
     t->cbs.throttle_new_deadline = 0;
+    t->cbs.spent = 0;
+}
+// release_queue order: earliest release_time first, FIFO among equals
+static int __release_before(void *a, void *b)
+{
+    struct release_queue_entry *x = a, *y = b;
+    if (x->release_time != y->release_time)
+        return x->release_time < y->release_time;
+    return x->seq < y->seq;
 }
-void thread_add_at(struct thread *t, int arrival_time)
+
+void thread_set_admission(int mode)
+{
+    admission = mode;
+}
+
+// switch policy between runs; -1 while threads are in the run queue,
+// whose order the current policy may still be tracking
+int thread_set_scheduler(struct thread_sched_ops *ops)
 {
+    if (!list_empty(&run_queue))
+        return -1;
+    sched = ops;
+    return 0;
+}
+
+struct thread_sched_ops *thread_get_scheduler(void)
+{
+    return sched;
+}
+
+// length of one unit of threading time: a kernel tick when 0 (default),
+// otherwise `us` microseconds timed with thrdstopus
+int thread_set_time_unit(int us)
+{
+    if (us < 0)
+        return -1;
+    time_unit_us = us;
+    return 0;
+}
+
+static int __thrdstop(int delay, int *context_id, void (*handler)(void *), void *arg)
+{
+    if (time_unit_us > 0)
+        return thrdstopus(delay * time_unit_us, context_id, handler, arg);
+    return thrdstop(delay, context_id, handler, arg);
+}
+
+// time the canceled timer ran for, in units
+static int __cancelthrdstop(int context_id, int is_exit)
+{
+    int consumed = cancelthrdstop(context_id, is_exit);
+    if (time_unit_us > 0 && consumed > 0)
+        consumed /= time_unit_us;
+    return consumed;
+}
+
+void thread_mutex_init(struct thread_mutex *m, int protocol, int ceiling)
+{
+    m->protocol = protocol;
+    m->ceiling = ceiling;
+    m->owner = NULL;
+    INIT_LIST_HEAD(&m->waiters);
+    INIT_LIST_HEAD(&m->held);
+}
+
+// each job of t holds m from `start` ticks into its processing time until
+// `end`, and m's ceiling covers t; -1 if the section does not fit the job
+// or overlaps another one on m
+int thread_critical(struct thread *t, struct thread_mutex *m, int start, int end)
+{
+    int i;
+
+    if (t->ncritical >= THREAD_CRITICAL_MAX || start < 0 || end <= start || end > t->processing_time)
+        return -1;
+    for (i = 0; i < t->ncritical; i++)
+        if (t->critical[i].m == m && start < t->critical[i].end && t->critical[i].start < end)
+            return -1;
+    // kept in order of start, the order they are locked in
+    for (i = t->ncritical; i > 0 && t->critical[i - 1].start > start; i--)
+        t->critical[i] = t->critical[i - 1];
+    t->critical[i].m = m;
+    t->critical[i].start = start;
+    t->critical[i].end = end;
+    t->critical[i].state = 0;
+    t->ncritical++;
+    if (m->ceiling == 0 || t->period < m->ceiling)
+        m->ceiling = t->period;
+    return 0;
+}
+
+// the most urgent thread blocked on m
+static struct thread *__first_waiter(struct thread_mutex *m)
+{
+    struct thread *th, *best = NULL;
+    list_for_each_entry(th, &m->waiters, mutex_wait)
+        if (best == NULL || th->effective_period < best->effective_period ||
+            (th->effective_period == best->effective_period && th->ID < best->ID))
+            best = th;
+    return best;
+}
+
+// recompute what t's mutexes lend it; a change is passed on to the owner
+// of the mutex t is blocked on
+static void __update_priority(struct thread *t)
+{
+    struct thread_mutex *m;
+    struct thread *w;
+    int p = t->period;
+
+    list_for_each_entry(m, &t->held, held) {
+        if (m->protocol == MUTEX_CEILING && m->ceiling > 0 && m->ceiling < p)
+            p = m->ceiling;
+        if ((w = __first_waiter(m)) != NULL && w->effective_period < p)
+            p = w->effective_period;
+    }
+    if (p == t->effective_period)
+        return;
+    t->effective_period = p;
+    if (sched->on_boost)
+        sched->on_boost(t);
+    if (t->blocked_on != NULL)
+        __update_priority(t->blocked_on->owner);
+}
+
+static void __mutex_take(struct thread *t, struct thread_mutex *m)
+{
+    m->owner = t;
+    list_add_tail(&m->held, &t->held);
+    __update_priority(t);
+}
+
+// t, just picked, finds m held: it leaves the run queue until m is
+// unlocked and lends its priority to the owner
+static void __mutex_wait(struct thread *t, struct thread_mutex *m)
+{
+    printf("thread#%d blocks on a mutex held by thread#%d at %d\n",
+           t->ID, m->owner->ID, threading_system_time);
+    list_del(&t->thread_list);
+    if (sched->on_block)
+        sched->on_block(t);
+    t->blocked_on = m;
+    list_add_tail(&t->mutex_wait, &m->waiters);
+    __update_priority(m->owner);
+}
+
+// unlock m; its most urgent waiter goes back to the run queue to try
+// again when it is picked. Returns 1 if a thread was woken.
+static int __mutex_give(struct thread *t, struct thread_mutex *m)
+{
+    struct thread *w = __first_waiter(m);
+
+    m->owner = NULL;
+    list_del(&m->held);
+    __update_priority(t);
+    if (w == NULL)
+        return 0;
+    list_del(&w->mutex_wait);
+    w->blocked_on = NULL;
+    list_add_tail(&w->thread_list, &run_queue);
+    if (sched->on_wake)
+        sched->on_wake(w);
+    return 1;
+}
+
+// lock what t needs before it runs: a pending thread_mutex_lock() and the
+// critical sections its job has reached. 0 if t had to block instead.
+static int __acquire(struct thread *t)
+{
+    int done = t->processing_time - t->remaining_time, i;
+
+    if (t->want != NULL) {
+        if (t->want->owner != NULL) {
+            __mutex_wait(t, t->want);
+            return 0;
+        }
+        __mutex_take(t, t->want);
+        t->want = NULL;
+    }
+    for (i = 0; i < t->ncritical; i++) {
+        if (t->critical[i].state != 0 || t->critical[i].start > done)
+            continue;
+        if (t->critical[i].m->owner != NULL) {
+            __mutex_wait(t, t->critical[i].m);
+            return 0;
+        }
+        __mutex_take(t, t->critical[i].m);
+        t->critical[i].state = 1;
+    }
+    return 1;
+}
+
+// unlock the critical sections t's job has run to the end of
+static void __leave_critical(struct thread *t)
+{
+    int done = t->processing_time - t->remaining_time, i;
+
+    for (i = t->ncritical - 1; i >= 0; i--) {
+        if (t->critical[i].state == 1 && t->critical[i].end <= done) {
+            t->critical[i].state = 2;
+            __mutex_give(t, t->critical[i].m);
+        }
+    }
+}
+
+// time is cut short where t's job enters or leaves a critical section
+static int __critical_time(struct thread *t, int time)
+{
+    int done = t->processing_time - t->remaining_time, i, at;
+
+    for (i = 0; i < t->ncritical; i++) {
+        if (t->critical[i].state == 2)
+            continue;
+        at = t->critical[i].state == 0 ? t->critical[i].start : t->critical[i].end;
+        if (at > done && at - done < time)
+            time = at - done;
+    }
+    return time;
+}
+
+// longest t can wait on lower-priority threads' critical sections: one
+// section at most under ceilings, one per such thread under inheritance
+static int __blocking(struct thread *t)
+{
+    struct thread *th;
+    int i, longest, sum = 0, max = 0, inherit = 0;
+
+    list_for_each_entry(th, &rt_threads, rt_list) {
+        if (th->period < t->period || (th->period == t->period && th->ID <= t->ID))
+            continue;
+        longest = 0;
+        for (i = 0; i < th->ncritical; i++) {
+            struct thread_mutex *m = th->critical[i].m;
+            // only a mutex that t or a more urgent thread locks can hold t up
+            if (m->ceiling > t->period)
+                continue;
+            if (th->critical[i].end - th->critical[i].start > longest)
+                longest = th->critical[i].end - th->critical[i].start;
+            if (m->protocol == MUTEX_INHERIT)
+                inherit = 1;
+        }
+        sum += longest;
+        if (longest > max)
+            max = longest;
+    }
+    return inherit ? sum : max;
+}
+
+static void __rt_task(struct thread *t, struct rt_task *task)
+{
+    task->id = t->ID;
+    task->wcet = t->mc.wcet_lo;
+    task->wcet_hi = t->mc.level == CRIT_HI ? t->mc.wcet_hi : 0;
+    task->budget = t->cbs.is_hard_rt ? 0 : t->cbs.budget;
+    task->period = t->period;
+    task->deadline = t->deadline;
+    task->blocking = __blocking(t);
+    task->jitter = 0;
+}
+
+// a server is analysed as a periodic task that runs its whole budget;
+// a deferrable one may run it at the end of one period and again at the
+// start of the next
+static void __server_task(struct thread_server *s, struct rt_task *task)
+{
+    task->id = -s->id;
+    task->wcet = s->budget;
+    task->wcet_hi = 0;
+    task->budget = 0;
+    task->period = s->period;
+    task->deadline = s->period;
+    task->blocking = 0;
+    task->jitter = s->type == SERVER_DEFERRABLE ? s->period - s->budget : 0;
+}
+
+// analyse the admitted threads plus t under the current policy;
+// returns -1 if t must not be queued
+static int __admit(struct thread *t)
+{
+    struct thread *th;
+    struct thread_server *s;
+    struct rt_task *ts;
+    int n = 0, i = 0, ok;
+
+    // on the list for now, so its critical sections count as blocking
+    list_add_tail(&t->rt_list, &rt_threads);
+    list_for_each_entry(th, &rt_threads, rt_list)
+        n++;
+    list_for_each_entry(s, &servers, all)
+        n++;
+    ts = (struct rt_task *)malloc(n * sizeof(struct rt_task));
+    list_for_each_entry(th, &rt_threads, rt_list)
+        __rt_task(th, &ts[i++]);
+    list_for_each_entry(s, &servers, all)
+        __server_task(s, &ts[i++]);
+    list_del_init(&t->rt_list);
+
+    ok = sched->admit == NULL || sched->admit(ts, n);
+
+    if (!ok) {
+        printf("admission: thread#%d %s, the set is not schedulable\n",
+               t->ID, admission == ADMIT_REJECT ? "rejected" : "admitted");
+        for (i = 0; i < n; i++)
+            printf("admission: %s#%d C=%d T=%d D=%d R=%d\n", ts[i].id < 0 ? "server" : "thread",
+                   ts[i].id < 0 ? -ts[i].id : ts[i].id, ts[i].wcet, ts[i].period, ts[i].deadline, ts[i].response);
+    }
+    free(ts);
+    return ok || admission != ADMIT_REJECT ? 0 : -1;
+}
+
+// admission counts the server for real-time threads added after it
+void thread_server_init(struct thread_server *s, int type, int budget, int period)
+{
+    static int _id = 1;
+    s->id = _id++;
+    s->type = type;
+    s->budget = budget;
+    s->period = period;
+    s->remaining = budget;
+    s->active_since = -1;
+    s->used = 0;
+    s->nrefill = 0;
+    s->next_refill = period;
+    INIT_LIST_HEAD(&s->members);
+    INIT_LIST_HEAD(&s->active);
+    list_add_tail(&s->all, &servers);
+}
+
+// run t, a non-real-time thread not yet added, under s; DM only. Its
+// priority is the server's, so it should not lock mutexes.
+int thread_serve(struct thread *t, struct thread_server *s)
+{
+    if (t->is_real_time) {
+        fprintf(2, "[ERROR] thread#%d is real-time and cannot run under a server\n", t->ID);
+        return -1;
+    }
+    t->server = s;
+    t->effective_period = s->period;
+    return 0;
+}
+
+// for EDF_VD, before t is added: a job of t is trusted to finish within
+// wcet_lo; a high-criticality one may need up to wcet_hi, and does get
+// it at the cost of the low ones. Its processing_time is what the job
+// really takes. -1 if the budgets do not make sense
+int thread_set_criticality(struct thread *t, int level, int wcet_lo, int wcet_hi)
+{
+    if (wcet_lo <= 0 || (level == CRIT_HI && wcet_hi < wcet_lo) || (level != CRIT_LO && level != CRIT_HI))
+        return -1;
+    t->mc.level = level;
+    t->mc.wcet_lo = wcet_lo;
+    t->mc.wcet_hi = level == CRIT_HI ? wcet_hi : wcet_lo;
+    return 0;
+}
+
+// returns -1, leaving t unqueued, if admission control rejects it
+int thread_add_at(struct thread *t, int arrival_time)
+{
+    if (t->is_real_time && list_empty(&t->rt_list)) {
+        if (admission != ADMIT_OFF && __admit(t) < 0)
+            return -1;
+        list_add_tail(&t->rt_list, &rt_threads);
+    }
+
     struct release_queue_entry *new_entry = (struct release_queue_entry *)malloc(sizeof(struct release_queue_entry));
     new_entry->thrd = t;
     new_entry->release_time = arrival_time;
+    new_entry->seq = release_seq++;
     t->arrival_time = arrival_time;
     // t->remaining_time = t->processing_time;
     if (t->is_real_time) {
         t->current_deadline = arrival_time + t->deadline;
     }
-    list_add_tail(&new_entry->thread_list, &release_queue);
+    if (heap_push(&release_queue, new_entry) < 0) {
+        fprintf(2, "[FATAL] cannot grow the release queue\n");
+        exit(1);
+    }
+    return 0;
+}
+
+// cycles run since the last mark, which moves to now
+static uint64 __cycles(void)
+{
+    uint64 now = cpucycles(), d = now - cycle_mark;
+    cycle_mark = now;
+    return d;
+}
+
+static void __record_usage(struct thread *t)
+{
+    struct thread_usage *u = (struct thread_usage *)malloc(sizeof(struct thread_usage));
+    u->ID = t->ID;
+    u->ran = t->ran;
+    u->cycles = t->cycles;
+    u->next = NULL;
+    *usage_tail = u;
+    usage_tail = &u->next;
+}
+
+static void __print_cycles(char *what, uint64 cycles, uint64 busy)
+{
+    int permille = busy ? cycles * 1000 / busy : 0;
+    printf("cpu: %s cycles=%d share=%d.%d%%\n", what, (int)cycles, permille / 10, permille % 10);
+}
+
+// one line per thread, then the runtime's own share of the busy time
+static void __print_usage(uint64 total)
+{
+    struct thread_usage *u;
+    uint64 busy = total - idle_cycles;
+
+    while ((u = usage) != NULL) {
+        printf("cpu: thread#%d ran=%d cycles=%d", u->ID, u->ran, (int)u->cycles);
+        if (u->ran > 0)
+            printf(" per_unit=%d", (int)(u->cycles / u->ran));
+        printf("\n");
+        usage = u->next;
+        free(u);
+    }
+    usage_tail = &usage;
+    __print_cycles("overhead", overhead_cycles, busy);
+    printf("cpu: idle cycles=%d total cycles=%d\n", (int)idle_cycles, (int)total);
 }
 
 void __release()
 {
-    struct release_queue_entry *cur, *nxt;
-    list_for_each_entry_safe(cur, nxt, &release_queue, thread_list) {
-        if (threading_system_time >= cur->release_time) {
-            cur->thrd->remaining_time = cur->thrd->processing_time;
-            cur->thrd->current_deadline = cur->release_time + cur->thrd->deadline;
-            list_add_tail(&cur->thrd->thread_list, &run_queue);
-            list_del(&cur->thread_list);
-            free(cur);
-        }
+    struct release_queue_entry *cur;
+    int i;
+    while ((cur = heap_top(&release_queue)) != NULL && threading_system_time >= cur->release_time) {
+        heap_pop(&release_queue);
+        cur->thrd->remaining_time = cur->thrd->processing_time;
+        cur->thrd->current_deadline = cur->release_time + cur->thrd->deadline;
+        for (i = 0; i < cur->thrd->ncritical; i++)
+            cur->thrd->critical[i].state = 0;
+        list_add_tail(&cur->thrd->thread_list, &run_queue);
+        trace_record(TRACE_RELEASE, cur->thrd->ID, cur->release_time, cur->thrd->current_deadline);
+        if (sched->on_release)
+            sched->on_release(cur->thrd);
+        free(cur);
     }
 }
 
-void __thread_exit(struct thread *to_remove)
+// unlink a thread whose last job is over and leave it to __reap();
+// current is left on the entry before it, and the caller picks what
+// runs next
+static void __thread_retire(struct thread *to_remove)
 {
+    trace_record(TRACE_EXIT, to_remove->ID, threading_system_time, 0);
     current = to_remove->thread_list.prev;
     list_del(&to_remove->thread_list);
+    if (sched->on_finish)
+        sched->on_finish(to_remove);
+    if (!list_empty(&to_remove->rt_list))
+        list_del(&to_remove->rt_list);
+    __record_usage(to_remove);
+    while (!list_empty(&to_remove->held))
+        __mutex_give(to_remove, list_entry(to_remove->held.next, struct thread_mutex, held));
+
+    arena_destroy(to_remove->arena);
+    list_add_tail(&to_remove->thread_list, &zombies);
+}
 
-    free(to_remove->stack);
-    free(to_remove);
+// free the exited threads; never called on a stack one of them owns
+static void __reap(void)
+{
+    struct thread *th, *tmp;
+
+    list_for_each_entry_safe(th, tmp, &zombies, thread_list) {
+        list_del(&th->thread_list);
+        free(th->stack);
+        free(th);
+    }
+}
 
+void __thread_exit(struct thread *to_remove)
+{
+    __thread_retire(to_remove);
     __schedule();
     __dispatch();
-    thrdresume(main_thrd_id);
+    longjmp(main_env, 1);
 }
 
 void thread_exit(void)
@@ -108,30 +672,42 @@ void thread_exit(void)
     }
 
     struct thread *to_remove = list_entry(current, struct thread, thread_list);
-    int consume_ticks = cancelthrdstop(to_remove->thrdstop_context_id, 1);
+    int consume_ticks = __cancelthrdstop(to_remove->thrdstop_context_id, 1);
+    to_remove->cycles += __cycles();
+    to_remove->ran += consume_ticks;
     threading_system_time += consume_ticks;
 
     __release();
     __thread_exit(to_remove);
 }
 
-void __finish_current()
+// the current thread's job is over: it waits for its next release,
+// or is retired if that was its last job. Either way it is off the run
+// queue and nothing is dispatched, so this is safe inside __schedule
+static void __next_job(struct thread *current_thread)
 {
-    struct thread *current_thread = list_entry(current, struct thread, thread_list);
-    --current_thread->n;
-
-    printf("thread#%d finish at %d\n",
-           current_thread->ID, threading_system_time, current_thread->n);
-
     if (current_thread->n > 0) {
         struct list_head *to_remove = current;
         current = current->prev;
         list_del(to_remove);
+        if (sched->on_finish)
+            sched->on_finish(current_thread);
         thread_add_at(current_thread, current_thread->current_deadline);
     } else {
-        __thread_exit(current_thread);
+        __thread_retire(current_thread);
     }
 }
+
+void __finish_current()
+{
+    struct thread *current_thread = list_entry(current, struct thread, thread_list);
+    --current_thread->n;
+
+    printf("thread#%d finish at %d\n",
+           current_thread->ID, threading_system_time, current_thread->n);
+    trace_record(TRACE_FINISH, current_thread->ID, threading_system_time, current_thread->n);
+    __next_job(current_thread);
+}
 void __rt_finish_current()
 {
     struct thread *current_thread = list_entry(current, struct thread, thread_list);
@@ -139,18 +715,25 @@ void __rt_finish_current()
 
     printf("thread#%d finish one cycle at %d: %d cycles left\n",
            current_thread->ID, threading_system_time, current_thread->n);
+    trace_record(TRACE_FINISH, current_thread->ID, threading_system_time, current_thread->n);
+    __next_job(current_thread);
+}
 
-    if (current_thread->n > 0) {
-        struct list_head *to_remove = current;
-        current = current->prev;
-        list_del(to_remove);
-        thread_add_at(current_thread, current_thread->current_deadline);
-        if (!current_thread->cbs.is_hard_rt) {
-            current_thread->cbs.remaining_budget = current_thread->cbs.budget;
-        }
-    } else {
-        __thread_exit(current_thread);
-    }
+// the policy gave up on the current job (EDF_VD in high-criticality
+// mode): it ends unfinished, letting go of its mutexes, and counts as
+// one of the thread's n
+static void __drop_current(void)
+{
+    struct thread *current_thread = list_entry(current, struct thread, thread_list);
+    --current_thread->n;
+
+    printf("thread#%d drops a job at %d: %d cycles left\n",
+           current_thread->ID, threading_system_time, current_thread->n);
+    trace_record(TRACE_DROP, current_thread->ID, threading_system_time, current_thread->remaining_time);
+    while (!list_empty(&current_thread->held))
+        __mutex_give(current_thread, list_entry(current_thread->held.next, struct thread_mutex, held));
+    current_thread->want = NULL;
+    __next_job(current_thread);
 }
 
 void switch_handler(void *arg)
@@ -158,20 +741,26 @@ void switch_handler(void *arg)
     uint64 elapsed_time = (uint64)arg;
     struct thread *current_thread = list_entry(current, struct thread, thread_list);
 
+    // on the stack of a live thread here
+    __reap();
+    current_thread->cycles += __cycles();
+    current_thread->ran += elapsed_time;
     threading_system_time += elapsed_time;
      __release();
     current_thread->remaining_time -= elapsed_time;
-    if (!current_thread->cbs.is_hard_rt) {
-        current_thread->cbs.remaining_budget -= elapsed_time;
-    }
+    if (sched->on_tick)
+        sched->on_tick(current_thread, elapsed_time);
     if (current_thread->is_real_time)
         if (threading_system_time > current_thread->current_deadline || 
             (threading_system_time == current_thread->current_deadline && current_thread->remaining_time > 0)) {
             // printf("system time: %d\n", threading_system_time);
             // printf("thread#%d still has remaining time = %d, current_deadline = %d\n", current_thread->ID, current_thread->remaining_time, current_thread->current_deadline);    
             printf("thread#%d misses a deadline at %d in swicth\n", current_thread->ID, threading_system_time);
+            trace_record(TRACE_MISS, current_thread->ID, threading_system_time, current_thread->current_deadline);
+            trace_dump();
             exit(0);
         }
+    __leave_critical(current_thread);
 
     if (current_thread->remaining_time <= 0) {
         if (current_thread->is_real_time)
@@ -184,17 +773,81 @@ void switch_handler(void *arg)
         current = current->prev;
         list_del(to_remove);
         list_add_tail(to_remove, &run_queue);
+        trace_record(TRACE_PREEMPT, current_thread->ID, threading_system_time, current_thread->remaining_time);
     }
 
     __release();
     __schedule();
     __dispatch();
-    thrdresume(main_thrd_id);
+    longjmp(main_env, 1);
+}
+
+// give up the CPU before the allocated time is used up; the time run
+// so far is charged in whole units and the thread goes back to the
+// run queue. The switch itself stays in user space: the kernel's saved
+// context is released and the thread is resumed with longjmp.
+void thread_yield(void)
+{
+    if (current == &run_queue) {
+        fprintf(2, "[FATAL] thread_yield is called on a nonexistent thread\n");
+        exit(1);
+    }
+
+    struct thread *current_thread = list_entry(current, struct thread, thread_list);
+    uint64 elapsed_time = __cancelthrdstop(current_thread->thrdstop_context_id, 1);
+    current_thread->thrdstop_context_id = -1;
+    if (setjmp(current_thread->env) == 0) {
+        current_thread->user_ctx = 1;
+        switch_handler((void *)elapsed_time);
+    }
+}
+
+static struct thread *__running(char *who)
+{
+    if (current == &run_queue) {
+        fprintf(2, "[FATAL] %s is called on a nonexistent thread\n", who);
+        exit(1);
+    }
+    return list_entry(current, struct thread, thread_list);
+}
+
+// a held mutex sends the caller through the scheduler, which hands it
+// over once it is unlocked
+void thread_mutex_lock(struct thread_mutex *m)
+{
+    struct thread *t = __running("thread_mutex_lock");
+
+    if (m->owner == t) {
+        fprintf(2, "[FATAL] thread#%d locks a mutex it holds\n", t->ID);
+        exit(1);
+    }
+    if (m->owner == NULL) {
+        __mutex_take(t, m);
+        return;
+    }
+    t->want = m;
+    thread_yield();
+}
+
+// yields if that woke a thread or lowered the caller's priority, as
+// something more urgent may be ready now
+void thread_mutex_unlock(struct thread_mutex *m)
+{
+    struct thread *t = __running("thread_mutex_unlock");
+    int period = t->effective_period;
+
+    if (m->owner != t) {
+        fprintf(2, "[FATAL] thread#%d unlocks a mutex it does not hold\n", t->ID);
+        exit(1);
+    }
+    if (__mutex_give(t, m) || t->effective_period != period)
+        thread_yield();
 }
 
 void __dispatch()
 {
     if (current == &run_queue) {
+        __switch_tls(NULL);
         return;
     }
 
@@ -206,23 +859,39 @@ void __dispatch()
     struct thread *current_thread = list_entry(current, struct thread, thread_list);
     if (current_thread->is_real_time && allocated_time == 0) {
         printf("thread#%d misses a deadline at %d in dispatch\n", current_thread->ID, current_thread->current_deadline);
+        trace_record(TRACE_MISS, current_thread->ID, threading_system_time, current_thread->current_deadline);
+        trace_dump();
         exit(0);
     }
 
     printf("dispatch thread#%d at %d: allocated_time=%d\n", current_thread->ID, threading_system_time, allocated_time);
+    trace_record(TRACE_DISPATCH, current_thread->ID, threading_system_time, allocated_time);
+    __switch_tls(current_thread);
 
     if (current_thread->buf_set) {
-        thrdstop(allocated_time, &(current_thread->thrdstop_context_id), switch_handler, (void *)allocated_time);
+        __thrdstop(allocated_time, &(current_thread->thrdstop_context_id), switch_handler, (void *)allocated_time);
+        if (current_thread->thrdstop_context_id < 0) {
+            fprintf(2, "[ERROR] cannot get a thrdstop context\n");
+            exit(1);
+        }
+        overhead_cycles += __cycles();
+        // a thread that yielded is resumed without the kernel; one that
+        // was preempted has its registers in the kernel's saved context
+        if (current_thread->user_ctx) {
+            current_thread->user_ctx = 0;
+            longjmp(current_thread->env, 1);
+        }
         thrdresume(current_thread->thrdstop_context_id);
     } else {
         current_thread->buf_set = 1;
         unsigned long new_stack_p = (unsigned long)current_thread->stack_p;
         current_thread->thrdstop_context_id = -1;
-        thrdstop(allocated_time, &(current_thread->thrdstop_context_id), switch_handler, (void *)allocated_time);
+        __thrdstop(allocated_time, &(current_thread->thrdstop_context_id), switch_handler, (void *)allocated_time);
         if (current_thread->thrdstop_context_id < 0) {
-            fprintf(2, "[ERROR] number of threads may exceed MAX_THRD_NUM\n");
+            fprintf(2, "[ERROR] cannot get a thrdstop context\n");
             exit(1);
         }
+        overhead_cycles += __cycles();
 
         // set sp to stack pointer of current thread.
         asm volatile("mv sp, %0"
@@ -243,38 +912,37 @@ void __schedule()
     };
 
     struct threads_sched_result r;
+    struct thread *th;
+    int period;
 
-#ifdef THREAD_SCHEDULER_DEFAULT
-    r = schedule_default(args);
-#endif
-
-#ifdef THREAD_SCHEDULER_HRRN
-    r = schedule_hrrn(args);
-#endif
-
-#ifdef THREAD_SCHEDULER_PRIORITY_RR
-    r = schedule_priority_rr(args);
-#endif
-
-#ifdef THREAD_SCHEDULER_EDF_CBS
-    r = schedule_edf_cbs(args);
-#endif
-
-#ifdef THREAD_SCHEDULER_DM
-    r = schedule_dm(args);
-#endif
-// #if defined(THREAD_SCHEDULER_HRRN)
-//     r = schedule_hrrn(args);
-// #elif defined(THREAD_SCHEDULER_PRIORITY_RR)
-//     r = schedule_priority_rr(args);
-// #elif defined(THREAD_SCHEDULER_EDF_CBS)
-//     r = schedule_edf_cbs(args);
-// #else
-//     r = schedule_default(args);
-// #endif
+    uint64 t0 = trace_cycles();
+    // pick again when the thread has to wait for a mutex, or locking one
+    // raised its priority and so the time it may run, or the policy
+    // dropped its job
+    for (;;) {
+        r = sched->pick(args);
+        if (r.scheduled_thread_list_member == &run_queue)
+            break;
+        th = list_entry(r.scheduled_thread_list_member, struct thread, thread_list);
+        if (r.allocated_time == 0 && th->mc.dropped) {
+            current = r.scheduled_thread_list_member;
+            __drop_current();
+            continue;
+        }
+        if (r.allocated_time == 0)
+            break;
+        period = th->effective_period;
+        if (__acquire(th) && th->effective_period == period) {
+            r.allocated_time = __critical_time(th, r.allocated_time);
+            break;
+        }
+    }
+    uint64 dt = trace_cycles() - t0;
 
     current = r.scheduled_thread_list_member;
     allocated_time = r.allocated_time;
+    trace_record(TRACE_PICK, current == &run_queue ? 0 : list_entry(current, struct thread, thread_list)->ID,
+                 threading_system_time, dt);
 }
 
 void back_to_main_handler(void *arg)
@@ -286,30 +954,134 @@ void back_to_main_handler(void *arg)
 
 void thread_start_threading()
 {
+    uint64 start = cpucycles();
+
+    __switch_tls(NULL);
     threading_system_time = 0;
     current = &run_queue;
+    cycle_mark = start;
+    overhead_cycles = idle_cycles = 0;
 
     // call thrdstop just for obtain an ID
     thrdstop(1000, &main_thrd_id, back_to_main_handler, (void *)0);
     cancelthrdstop(main_thrd_id, 0);
 
-    while (!list_empty(&run_queue) || !list_empty(&release_queue)) {
+    while (!list_empty(&run_queue) || !heap_empty(&release_queue)) {
         __release();
         __schedule();
-        cancelthrdstop(main_thrd_id, 0);
+        // threads come back here with longjmp once nothing is runnable
+        setjmp(main_env);
+        __reap();
         __dispatch();
 
-        if (list_empty(&run_queue) && list_empty(&release_queue)) {
+        if (list_empty(&run_queue) && heap_empty(&release_queue)) {
             break;
         }
 
         // no thread in run_queue, release_queue not empty
         printf("run_queue is empty, sleep for %d ticks\n", allocated_time);
+        trace_record(TRACE_IDLE, 0, threading_system_time, allocated_time);
+        overhead_cycles += __cycles();
         sleeping = 1;
-        thrdstop(allocated_time, &main_thrd_id, back_to_main_handler, (void *)allocated_time);
+        __thrdstop(allocated_time, &main_thrd_id, back_to_main_handler, (void *)allocated_time);
         while (sleeping) {
             // zzz...
         }
+        idle_cycles += __cycles();
     }
+    __reap();
+    overhead_cycles += __cycles();
+    trace_dump();
+    __print_usage(cycle_mark - start);
 }
 
+// drop every thread not on hart from the queues
+static void __keep_partition(int hart)
+{
+    struct thread *th, *tmp;
+    int i, n = release_queue.size;
+    void **items = (void **)malloc(n * sizeof(void *));
+
+    memmove(items, release_queue.items, n * sizeof(void *));
+    release_queue.size = 0;
+    for (i = 0; i < n; i++) {
+        struct release_queue_entry *e = items[i];
+        if (e->thrd->hart == hart)
+            heap_push(&release_queue, e);
+        else
+            free(e);
+    }
+    free(items);
+
+    list_for_each_entry_safe(th, tmp, &run_queue, thread_list)
+        if (th->hart != hart)
+            list_del(&th->thread_list);
+    list_for_each_entry_safe(th, tmp, &rt_threads, rt_list)
+        if (th->hart != hart)
+            list_del_init(&th->rt_list);
+}
+
+static void __print_load(int load)
+{
+    printf("%d.%d%d%d", load / 1000, load / 100 % 10, load / 10 % 10, load % 10);
+}
+
+// Partitioned multiprocessor run: the real-time threads are packed onto
+// harts first-fit decreasing by utilization, each hart's share passing
+// the current policy's admission test, and every hart runs its share in
+// a forked process pinned to it. Other threads go with hart 0.
+// Returns -1, running nothing, if some thread fits on no hart.
+int thread_start_partitioned(int harts)
+{
+    struct thread *th;
+    struct rt_task *ts;
+    int *part;
+    int n = 0, i = 0, h, unplaced;
+
+    list_for_each_entry(th, &rt_threads, rt_list)
+        n++;
+    ts = (struct rt_task *)malloc(n * sizeof(struct rt_task));
+    part = (int *)malloc(n * sizeof(int));
+    list_for_each_entry(th, &rt_threads, rt_list)
+        __rt_task(th, &ts[i++]);
+    unplaced = rta_partition(ts, n, harts, part, sched->admit);
+    i = 0;
+    list_for_each_entry(th, &rt_threads, rt_list)
+        th->hart = part[i++];
+
+    for (h = 0; h < harts; h++) {
+        printf("partition: hart#%d U=", h);
+        __print_load(rta_load(ts, n, part, h));
+        for (i = 0; i < n; i++)
+            if (part[i] == h)
+                printf(" thread#%d", ts[i].id);
+        printf("\n");
+    }
+    for (i = 0; i < n; i++)
+        if (part[i] < 0)
+            printf("partition: thread#%d fits on no hart\n", ts[i].id);
+    free(ts);
+    free(part);
+    if (unplaced)
+        return -1;
+
+    for (h = 0; h < harts; h++) {
+        int pid = fork();
+        if (pid < 0) {
+            fprintf(2, "[FATAL] cannot fork for hart#%d\n", h);
+            exit(1);
+        }
+        if (pid == 0) {
+            if (setaffinity(h) < 0) {
+                fprintf(2, "[FATAL] hart#%d is not running\n", h);
+                exit(1);
+            }
+            __keep_partition(h);
+            thread_start_threading();
+            exit(0);
+        }
+    }
+    for (h = 0; h < harts; h++)
+        wait(0);
+    return 0;
+}
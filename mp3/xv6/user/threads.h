@@ -2,8 +2,85 @@
 #define THREADS_H_
 
 #include "user/list.h"
+#include "user/setjmp.h"
 #include "kernel/types.h"
 
+#define THREAD_KEYS_MAX 8 // thread-local slots per thread
+#define THREAD_ARENA_SIZE 1024 // bytes of per-thread small-object heap
+
+// admission control for real-time threads, run when one is first added
+#define ADMIT_OFF 0    // queue every thread (default)
+#define ADMIT_WARN 1   // report a set that fails the analysis, queue anyway
+#define ADMIT_REJECT 2 // do not queue a thread that makes the set fail
+
+// how a mutex raises its owner's DM priority
+#define MUTEX_INHERIT 0 // to that of the most urgent thread blocked on it
+#define MUTEX_CEILING 1 // to its ceiling as soon as it is locked
+
+#define THREAD_CRITICAL_MAX 4 // critical sections per job
+
+// how a server gets its budget back
+#define SERVER_SPORADIC 0   // what it used, one period after it started using it
+#define SERVER_DEFERRABLE 1 // all of it at every multiple of the period
+
+#define THREAD_SERVER_REFILLS 8 // pending sporadic replenishments
+
+// criticality under EDF_VD
+#define CRIT_LO 0 // dropped when a high-criticality thread overruns
+#define CRIT_HI 1 // guaranteed up to its pessimistic budget
+
+struct arena;
+struct thread;
+
+// A lock between threads. A thread that finds it held leaves the run
+// queue until it is unlocked; meanwhile the owner runs at the blocked
+// thread's priority (MUTEX_INHERIT), or always at the ceiling while it
+// holds the mutex (MUTEX_CEILING), so a thread of middle priority cannot
+// stretch the wait. Priorities follow DM: a shorter period is more urgent.
+struct thread_mutex {
+    int protocol;
+    // period of the most urgent thread that locks it, 0 if not known yet
+    int ceiling;
+    struct thread *owner;
+    // threads blocked on it, through thread.mutex_wait
+    struct list_head waiters;
+    // on the owner's list of held mutexes
+    struct list_head held;
+};
+
+// Runs aperiodic (non-real-time) threads under DM. A thread attached
+// with thread_serve() runs at the server's priority, its period, while
+// the server has budget, and behind every other thread once it is used
+// up. The real-time threads see the server as one more periodic task
+// taking at most budget per period (a deferrable server can take it
+// twice in a row, which the analysis counts as release jitter), so
+// their guarantees hold while the aperiodic work no longer waits for
+// idle time.
+struct thread_server {
+    int id;
+    int type;
+    int budget;
+    int period;
+    int remaining;
+    // sporadic: start of the stretch it is consuming in, -1 if none,
+    // what it used since, and the budget owed at later times
+    int active_since;
+    int used;
+    struct {
+        int time;
+        int amount;
+    } refill[THREAD_SERVER_REFILLS];
+    int nrefill;
+    // deferrable: when the budget is next refilled
+    int next_refill;
+    // its threads in the run queue, through thread.server_list
+    struct list_head members;
+    // on the policy's list while it has threads queued
+    struct list_head active;
+    // on the list of servers admission control counts
+    struct list_head all;
+};
+
 struct thread {
     void (*fp)(void *arg);
     void *arg;
@@ -16,6 +93,10 @@ struct thread {
     // kernel stores the thread context,
     // this is index for that.
     int thrdstop_context_id;
+    // a thread that gave up the CPU itself is saved here instead,
+    // and user_ctx is 1 until it is resumed without the kernel
+    jmp_buf env;
+    int user_ctx;
     // a unique ID
     int ID;
     // 1 if real-time, 0 if non-real-time
@@ -44,24 +125,98 @@ struct thread {
         int is_throttled;             // 1 if the thread is currently throttled
         int throttled_arrived_time;   // Time reset remaining budget
         int throttle_new_deadline;    // New deadline assigned after throttling
+        int spent;                    // EDF_GRUB: budget drained short of a tick, in 1/BW_ONE
+        struct list_head soft_list;   // on EDF_CBS's soft thread list while in the run queue
     } cbs;
+    // MLFQ: level (0 is served first), ticks used at it, and the boost
+    // period the two belong to
+    struct {
+        int level;
+        int used;
+        int epoch;
+    } mlfq;
+    // slots in the policy's heaps while in the run queue (DM, EDF_CBS, EDF_VD)
+    int rq_index;
+    int dl_index;
+    // on the list of real-time threads added and not yet exited
+    struct list_head rt_list;
+    // DM priority: the period, or shorter while a mutex it holds lends it more
+    int effective_period;
+    // mutexes it holds, and the one it is blocked on (NULL if none)
+    struct list_head held;
+    struct thread_mutex *blocked_on;
+    struct list_head mutex_wait;
+    // a thread_mutex_lock() not yet granted
+    struct thread_mutex *want;
+    // mutexes each job holds, from `start` ticks of its processing time to
+    // `end`; state is 0 before the section, 1 inside it, 2 after it
+    struct {
+        struct thread_mutex *m;
+        int start;
+        int end;
+        int state;
+    } critical[THREAD_CRITICAL_MAX];
+    int ncritical;
+    // server it runs under, NULL if none, and its place among the
+    // server's queued threads
+    struct thread_server *server;
+    struct list_head server_list;
+    // EDF_VD: criticality, the budgets a job is held to in low- and
+    // high-criticality mode, and what the current job has run. dropped
+    // marks a job the policy gives up on unfinished, queued on list; a
+    // high job past wcet_lo is on list too
+    struct {
+        int level;
+        int wcet_lo;
+        int wcet_hi;
+        int executed;
+        int counted;
+        int dropped;
+        struct list_head list;
+    } mc;
+    // hart it runs on under thread_start_partitioned, 0 otherwise
+    int hart;
+    // CPU time it has used: units charged, and cycles actually run
+    int ran;
+    uint64 cycles;
+    // thread-local storage, tp points at tls while the thread runs
+    void *tls[THREAD_KEYS_MAX];
+    // small mallocs made by this thread come from here
+    struct arena *arena;
 };
 
 struct release_queue_entry {
     struct thread *thrd;
-    // for linked list
-    struct list_head thread_list;
     // the time when `thrd` should be released to run queue, measured in ticks
     int release_time;
+    // order of thread_add_at calls, breaks ties between equal release_time
+    int seq;
 };
 
 struct thread *thread_create(void (*f)(void *), void *arg, int is_real_time, int processing_time, int period, int n);
 void thread_set_weight(struct thread *t, int weight);
 void thread_set_priority(struct thread *t, int priority);
 void init_thread_cbs(struct thread *th, int budget, int is_hard_rt);
-void thread_add_at(struct thread *t, int arrival_time);
+int thread_add_at(struct thread *t, int arrival_time);
+void thread_set_admission(int mode);
+struct thread_sched_ops;
+int thread_set_scheduler(struct thread_sched_ops *ops);
+struct thread_sched_ops *thread_get_scheduler(void);
+int thread_set_time_unit(int us);
 void thread_exit(void);
+void thread_yield(void);
 void thread_start_threading();
+int thread_start_partitioned(int harts);
 void thread_add_direct(struct thread *t);
+void thread_mutex_init(struct thread_mutex *m, int protocol, int ceiling);
+void thread_mutex_lock(struct thread_mutex *m);
+void thread_mutex_unlock(struct thread_mutex *m);
+int thread_critical(struct thread *t, struct thread_mutex *m, int start, int end);
+void thread_server_init(struct thread_server *s, int type, int budget, int period);
+int thread_serve(struct thread *t, struct thread_server *s);
+int thread_set_criticality(struct thread *t, int level, int wcet_lo, int wcet_hi);
+int thread_key_create(void);
+void thread_setspecific(int key, void *value);
+void *thread_getspecific(int key);
 
 #endif // THREADS_H_
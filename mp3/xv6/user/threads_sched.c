@@ -3,12 +3,13 @@
 #include "user/list.h"
 #include "user/threads.h"
 #include "user/threads_sched.h"
+#include "user/rtanalysis.h"
+#include "user/trace.h"
 #include <limits.h>
 #define NULL 0
 
 /* default scheduling algorithm */
-#ifdef THREAD_SCHEDULER_DEFAULT
-struct threads_sched_result schedule_default(struct threads_sched_args args)
+static struct threads_sched_result schedule_default(struct threads_sched_args args)
 {
     struct thread *thread_with_smallest_id = NULL;
     struct thread *th = NULL;
@@ -28,13 +29,11 @@ struct threads_sched_result schedule_default(struct threads_sched_args args)
 
     return r;
 }
-#endif
 
 /* MP3 Part 1 - Non-Real-Time Scheduling */
 
 // HRRN
-#ifdef THREAD_SCHEDULER_HRRN
-struct threads_sched_result schedule_hrrn(struct threads_sched_args args)
+static struct threads_sched_result schedule_hrrn(struct threads_sched_args args)
 {
     struct thread *candidate = NULL;
     struct thread *th = NULL;
@@ -68,11 +67,9 @@ struct threads_sched_result schedule_hrrn(struct threads_sched_args args)
 
     return r;
 }
-#endif
 
-#ifdef THREAD_SCHEDULER_PRIORITY_RR
 // priority Round-Robin(RR)
-struct threads_sched_result schedule_priority_rr(struct threads_sched_args args) 
+static struct threads_sched_result schedule_priority_rr(struct threads_sched_args args) 
 {
     static struct curr_state {
         int last_run_time;
@@ -160,36 +157,91 @@ struct threads_sched_result schedule_priority_rr(struct threads_sched_args args)
     
     return r;
 }
-#endif
 
 /* MP3 Part 2 - Real-Time Scheduling*/
 
-#if defined(THREAD_SCHEDULER_EDF_CBS) || defined(THREAD_SCHEDULER_DM)
-static struct thread *__check_deadline_miss(struct list_head *run_queue, int current_time)
+// The run queue list stays the source of truth for threads.c; the
+// policies also index its threads in heaps, kept in step by
+// sched_enqueue()/sched_dequeue(): `ready` in the policy's order,
+// `deadlines` by current_deadline for miss detection.
+static void __ready_moved(void *t, int index)
 {
-    struct thread *th = NULL;
-    struct thread *thread_missing_deadline = NULL;
-    list_for_each_entry(th, run_queue, thread_list) {
-        if (th->current_deadline <= current_time) {
-            if (thread_missing_deadline == NULL)
-                thread_missing_deadline = th;
-            else if (th->ID < thread_missing_deadline->ID)
-                thread_missing_deadline = th;
-        }
-    }
-    return thread_missing_deadline;
+    ((struct thread *)t)->rq_index = index;
+}
+
+static void __deadline_moved(void *t, int index)
+{
+    ((struct thread *)t)->dl_index = index;
+}
+
+static int __deadline_before(void *a, void *b)
+{
+    struct thread *x = a, *y = b;
+    if (x->current_deadline != y->current_deadline)
+        return x->current_deadline < y->current_deadline;
+    return x->ID < y->ID;
+}
+
+static struct heap deadlines = HEAP_INIT(__deadline_before, __deadline_moved);
+
+// smallest ID among the threads whose deadline is not after current_time;
+// only the part of the heap holding such threads is visited
+static struct thread *__due_min_id(struct heap *q, int i, int current_time, struct thread *best)
+{
+    if (i >= q->size)
+        return best;
+    struct thread *th = q->items[i];
+    if (th->current_deadline > current_time)
+        return best;
+    if (best == NULL || th->ID < best->ID)
+        best = th;
+    best = __due_min_id(q, 2 * i + 1, current_time, best);
+    return __due_min_id(q, 2 * i + 2, current_time, best);
+}
+
+static struct thread *__check_deadline_miss(int current_time)
+{
+    return __due_min_id(&deadlines, 0, current_time, NULL);
+}
+
+// earliest release_time below `before` among the entries of the release
+// heap at and under index i that match(); `before` if there is none.
+// Children never release earlier than their parent, so a subtree whose
+// root is not below the bound is skipped without being visited.
+static int __earliest_release(struct heap *q, int i, int before,
+                              int (*match)(struct release_queue_entry *e, void *arg), void *arg)
+{
+    if (i >= q->size)
+        return before;
+    struct release_queue_entry *e = q->items[i];
+    if (e->release_time >= before)
+        return before;
+    if (match(e, arg))
+        return e->release_time;
+    before = __earliest_release(q, 2 * i + 1, before, match, arg);
+    return __earliest_release(q, 2 * i + 2, before, match, arg);
+}
+
+static int __released_after(struct release_queue_entry *e, void *current_time)
+{
+    return e->release_time > *(int *)current_time;
+}
+
+// ticks until the next release after current_time, -1 if none
+static int __sleep_time(struct heap *release_queue, int current_time)
+{
+    int next = __earliest_release(release_queue, 0, INT_MAX, __released_after, &current_time);
+    return next == INT_MAX ? -1 : next - current_time;
 }
-#endif
 
-#ifdef THREAD_SCHEDULER_DM
 /* Deadline-Monotonic Scheduling */
 static int __dm_thread_cmp(struct thread *a, struct thread *b)
 {
-    // compare a with b (period = deadline)
+    // compare a with b (period = deadline), a mutex may lend a shorter one
     // if 1, a win
     // if -1, b win
-    if (a->period < b->period) return 1;  // a has higher priority
-    else if (a->period > b->period) return -1; // b has higher priority
+    if (a->effective_period < b->effective_period) return 1;  // a has higher priority
+    else if (a->effective_period > b->effective_period) return -1; // b has higher priority
     else {
         // For threads with the same deadline, use ID as tiebreaker (smaller ID = higher priority)
         if (a->ID < b->ID) return 1;  // a has higher priority
@@ -197,86 +249,200 @@ static int __dm_thread_cmp(struct thread *a, struct thread *b)
     }
 }
 
-struct threads_sched_result schedule_dm(struct threads_sched_args args) 
+static int __dm_before(void *a, void *b)
+{
+    return __dm_thread_cmp(a, b) > 0;
+}
+
+static struct heap dm_ready = HEAP_INIT(__dm_before, __ready_moved);
+
+// Servers with threads queued. Non-real-time threads have no deadline
+// to miss and stay out of `deadlines`; a served one's effective_period
+// follows the server's budget, set on every decision.
+static LIST_HEAD(dm_servers);
+// time of the last decision, where the run on_tick charges began
+static int dm_now = 0;
+
+static int __server_period(struct thread_server *s)
+{
+    return s->remaining > 0 ? s->period : INT_MAX;
+}
+
+static void __server_prioritize(struct thread_server *s)
+{
+    struct thread *t;
+    int period = __server_period(s);
+
+    list_for_each_entry(t, &s->members, server_list) {
+        if (t->effective_period == period)
+            continue;
+        t->effective_period = period;
+        if (t->rq_index >= 0)
+            heap_fix(&dm_ready, t->rq_index);
+    }
+}
+
+// sporadic: the stretch ends, and what it used comes back one period
+// after it began. With no slot left the latest refill absorbs it, which
+// only delays that one.
+static void __server_close(struct thread_server *s)
+{
+    if (s->type != SERVER_SPORADIC || s->active_since < 0)
+        return;
+    if (s->used > 0) {
+        if (s->nrefill == THREAD_SERVER_REFILLS) {
+            s->refill[s->nrefill - 1].time = s->active_since + s->period;
+            s->refill[s->nrefill - 1].amount += s->used;
+        } else {
+            s->refill[s->nrefill].time = s->active_since + s->period;
+            s->refill[s->nrefill].amount = s->used;
+            s->nrefill++;
+        }
+    }
+    s->active_since = -1;
+    s->used = 0;
+}
+
+// add the budget s is owed by now
+static void __server_refill(struct thread_server *s, int now)
+{
+    int i = 0;
+
+    if (s->type == SERVER_DEFERRABLE) {
+        if (now >= s->next_refill) {
+            s->remaining = s->budget;
+            s->next_refill = (now / s->period + 1) * s->period;
+        }
+        return;
+    }
+    while (i < s->nrefill && s->refill[i].time <= now)
+        s->remaining += s->refill[i++].amount;
+    if (i > 0) {
+        s->nrefill -= i;
+        memmove(s->refill, s->refill + i, s->nrefill * sizeof(s->refill[0]));
+    }
+}
+
+static void __dm_release(struct thread *t)
+{
+    struct thread_server *s = t->server;
+
+    if (s != NULL) {
+        if (list_empty(&s->members))
+            list_add_tail(&s->active, &dm_servers);
+        list_add_tail(&t->server_list, &s->members);
+        t->effective_period = __server_period(s);
+    } else if (!t->is_real_time) {
+        // no guarantee to keep, so only time the real-time threads leave
+        t->effective_period = INT_MAX;
+    }
+    heap_push(&dm_ready, t);
+    if (t->is_real_time)
+        heap_push(&deadlines, t);
+}
+
+static void __dm_finish(struct thread *t)
+{
+    struct thread_server *s = t->server;
+
+    heap_remove(&dm_ready, t->rq_index);
+    if (s != NULL) {
+        list_del_init(&t->server_list);
+        if (list_empty(&s->members)) {
+            __server_close(s);
+            list_del_init(&s->active);
+        }
+    }
+    if (t->is_real_time)
+        heap_remove(&deadlines, t->dl_index);
+}
+
+// time a served thread ran at the server's priority comes out of its
+// budget; in the background it is free
+static void __dm_tick(struct thread *t, int elapsed)
+{
+    struct thread_server *s = t->server;
+
+    if (s == NULL || t->effective_period != s->period)
+        return;
+    if (s->active_since < 0)
+        s->active_since = dm_now;
+    s->used += elapsed;
+    s->remaining -= elapsed;
+    if (s->remaining <= 0) {
+        s->remaining = 0;
+        __server_close(s);
+        __server_prioritize(s);
+    }
+}
+
+// a thread blocked on a mutex stays in `deadlines`, so its misses are seen
+static void __dm_block(struct thread *t)
+{
+    heap_remove(&dm_ready, t->rq_index);
+}
+
+static void __dm_wake(struct thread *t)
+{
+    heap_push(&dm_ready, t);
+}
+
+static void __dm_boost(struct thread *t)
+{
+    if (t->rq_index >= 0)
+        heap_fix(&dm_ready, t->rq_index);
+}
+
+// a release of e->thrd would preempt the candidate
+static int __dm_preempts(struct release_queue_entry *e, void *candidate)
+{
+    return __dm_thread_cmp(candidate, e->thrd) < 0;
+}
+
+static struct threads_sched_result schedule_dm(struct threads_sched_args args) 
 {
     struct threads_sched_result r;
+    struct thread_server *s;
 
-    // printf("current_time = %d\n",args.current_time);
-
-    // struct thread *temp;
-    // if(!list_empty(args.run_queue)){
-    //     printf("run queue:\n");
-    //     list_for_each_entry(temp, args.run_queue, thread_list){
-    //         printf("[%d, %d, %d, %d, %d]\n", temp->ID, temp->arrival_time, temp->current_deadline, temp->period, temp->remaining_time);
-    //     }
-    // }
-    // else printf("runqueue empty\n");
-    // struct release_queue_entry *tempp;
-    // if(!list_empty(args.release_queue)){
-    //     printf("release queue:\n");
-    //     list_for_each_entry(tempp, args.release_queue, thread_list){
-    //         printf("[%d, %d]\n", tempp->thrd->ID, tempp->release_time);
-    //     }
-    // }
-    // else printf("releasequeue empty\n");
+    dm_now = args.current_time;
+    list_for_each_entry(s, &dm_servers, active) {
+        __server_refill(s, args.current_time);
+        __server_prioritize(s);
+    }
 
     // sleep
     if (list_empty(args.run_queue)) {
         r.scheduled_thread_list_member = args.run_queue;
-        
-        int time = -1;
-        struct release_queue_entry *timeth;
-        list_for_each_entry(timeth, args.release_queue, thread_list){
-            if(time == -1 && timeth->release_time > args.current_time){
-                time = timeth->release_time - args.current_time;
-                continue;
-            }
-            
-            if(time > timeth->release_time - args.current_time && timeth->release_time > args.current_time){
-                time = timeth->release_time - args.current_time;
-            }
-        }
         // time = 1;
-        r.allocated_time = time;
+        r.allocated_time = __sleep_time(args.release_queue, args.current_time);
         return r;
     }
 
     // check missed deadline
-    struct thread *missed_deadline_thread = __check_deadline_miss(args.run_queue, args.current_time);
+    struct thread *missed_deadline_thread = __check_deadline_miss(args.current_time);
     if (missed_deadline_thread != NULL) {
         r.scheduled_thread_list_member = &missed_deadline_thread->thread_list;
         r.allocated_time = 0;
         return r;
     }
     
-    // find candidate
-    struct thread *candidate = NULL;
-    struct thread *th;
-    // find for highest priority in runqueue
-    list_for_each_entry(th, args.run_queue, thread_list){
-        if(candidate == NULL || __dm_thread_cmp(candidate, th) < 0){
-            candidate = th;
-        }
-    }
+    // highest priority in runqueue
+    struct thread *candidate = heap_top(&dm_ready);
 
     // find for possible timeslice in releasequeue
     int temp_time = candidate->remaining_time;
-    struct release_queue_entry *rth;
-    list_for_each_entry(rth, args.release_queue, thread_list){
-        th = rth->thrd;
-        if(__dm_thread_cmp(candidate, th) < 0 && rth->release_time - args.current_time < temp_time){ // candidate lose priority
-            temp_time = rth->release_time - args.current_time;
-        }
-    }
+    s = candidate->server;
+    if (s != NULL && candidate->effective_period == s->period && s->remaining < temp_time)
+        temp_time = s->remaining;
+    temp_time = __earliest_release(args.release_queue, 0, args.current_time + temp_time,
+                                   __dm_preempts, candidate) - args.current_time;
 
     r.scheduled_thread_list_member = &candidate->thread_list;
     r.allocated_time = temp_time;
 
     return r;
 }
-#endif
 
-#ifdef THREAD_SCHEDULER_EDF_CBS
 // EDF with CBS comparation
 static int __edf_thread_cmp(struct thread *a, struct thread *b)
 {
@@ -290,13 +456,173 @@ static int __edf_thread_cmp(struct thread *a, struct thread *b)
         else return 0;
     }
 }
+
+static int __edf_before(void *a, void *b)
+{
+    return __edf_thread_cmp(a, b);
+}
+
+// unthrottled threads in EDF order; throttled soft threads wait in
+// `throttled` by the deadline at which they are replenished
+static struct heap edf_ready = HEAP_INIT(__edf_before, __ready_moved);
+static struct heap throttled = HEAP_INIT(__edf_before, __ready_moved);
+// soft threads in the run queue, re-examined on every decision
+static LIST_HEAD(soft_threads);
+// set while EDF_GRUB decides: budgets last as long as __budget_time says
+static int reclaiming = 0;
+
+static void __edf_release(struct thread *t)
+{
+    heap_push(t->cbs.is_throttled ? &throttled : &edf_ready, t);
+    heap_push(&deadlines, t);
+    if (!t->cbs.is_hard_rt)
+        list_add_tail(&t->cbs.soft_list, &soft_threads);
+}
+
+// a soft thread starts its next period with a full budget
+static void __edf_finish(struct thread *t)
+{
+    heap_remove(t->cbs.is_throttled ? &throttled : &edf_ready, t->rq_index);
+    heap_remove(&deadlines, t->dl_index);
+    if (!t->cbs.is_hard_rt) {
+        list_del(&t->cbs.soft_list);
+        t->cbs.remaining_budget = t->cbs.budget;
+        t->cbs.spent = 0;
+    }
+}
+
+// only ever called on the thread just picked, so never a throttled one
+static void __edf_block(struct thread *t)
+{
+    heap_remove(&edf_ready, t->rq_index);
+    if (!t->cbs.is_hard_rt)
+        list_del(&t->cbs.soft_list);
+}
+
+static void __edf_wake(struct thread *t)
+{
+    heap_push(t->cbs.is_throttled ? &throttled : &edf_ready, t);
+    if (!t->cbs.is_hard_rt)
+        list_add_tail(&t->cbs.soft_list, &soft_threads);
+}
+
+static void __edf_tick(struct thread *t, int elapsed)
+{
+    if (!t->cbs.is_hard_rt)
+        t->cbs.remaining_budget -= elapsed;
+}
+
+// earliest current_deadline in (after, before) among the throttled
+// threads at and under index i; `before` if there is none
+static int __earliest_replenish(struct heap *q, int i, int after, int before)
+{
+    if (i >= q->size)
+        return before;
+    struct thread *th = q->items[i];
+    if (th->current_deadline >= before)
+        return before;
+    if (th->current_deadline > after)
+        return th->current_deadline;
+    before = __earliest_replenish(q, 2 * i + 1, after, before);
+    return __earliest_replenish(q, 2 * i + 2, after, before);
+}
+
+// GRUB reclaiming: the running soft server's budget drains at the active
+// bandwidth instead of at full rate, so the share other threads leave
+// unused goes to it. A job's bandwidth is active from its release to its
+// 0-lag time, when its leftover budget would have run out at its own rate,
+// which keeps the hard threads' guarantees. Bandwidths are in 1/BW_ONE.
+#define BW_ONE (1 << 16)
+
+struct grub_inactive {
+    int at;
+    int bw;
+};
+
+static int __grub_before(void *a, void *b)
+{
+    return ((struct grub_inactive *)a)->at < ((struct grub_inactive *)b)->at;
+}
+
+static int active_bw = 0;
+// bandwidth of finished jobs, waiting for their 0-lag time
+static struct heap grub_inactive = HEAP_INIT(__grub_before, NULL);
+
+static int __bandwidth(struct thread *t)
+{
+    return ((uint64)t->cbs.budget * BW_ONE + t->period - 1) / t->period;
+}
+
+static int __drain_rate(void)
+{
+    if (active_bw >= BW_ONE)
+        return BW_ONE;
+    return active_bw > 0 ? active_bw : 1;
+}
+
+// ticks until t's budget runs out
+static int __budget_time(struct thread *t)
+{
+    if (!reclaiming)
+        return t->cbs.remaining_budget;
+    if (t->cbs.remaining_budget <= 0)
+        return 0;
+    int rate = __drain_rate();
+    return ((uint64)t->cbs.remaining_budget * BW_ONE - t->cbs.spent + rate - 1) / rate;
+}
+
+static void __grub_expire(int current_time)
+{
+    struct grub_inactive *g;
+    while ((g = heap_top(&grub_inactive)) != NULL && g->at <= current_time) {
+        heap_pop(&grub_inactive);
+        active_bw -= g->bw;
+        free(g);
+    }
+}
+
+static void __grub_release(struct thread *t)
+{
+    active_bw += __bandwidth(t);
+    __edf_release(t);
+}
+
+static void __grub_finish(struct thread *t)
+{
+    struct grub_inactive *g = (struct grub_inactive *)malloc(sizeof(struct grub_inactive));
+    int left = t->cbs.is_hard_rt || t->cbs.remaining_budget < 0 ? 0 : t->cbs.remaining_budget;
+
+    g->bw = __bandwidth(t);
+    g->at = t->current_deadline - left * t->period / t->cbs.budget;
+    if (heap_push(&grub_inactive, g) < 0) {
+        // cannot track it: give the bandwidth back now
+        active_bw -= g->bw;
+        free(g);
+    }
+    __edf_finish(t);
+}
+
+static void __grub_tick(struct thread *t, int elapsed)
+{
+    if (t->cbs.is_hard_rt)
+        return;
+    int used = elapsed * __drain_rate() + t->cbs.spent;
+    t->cbs.remaining_budget -= used / BW_ONE;
+    t->cbs.spent = used % BW_ONE;
+}
+
+static int __edf_preempts(struct release_queue_entry *e, void *candidate)
+{
+    return !e->thrd->cbs.is_throttled && __edf_thread_cmp(candidate, e->thrd) < 1;
+}
+
 //  EDF_CBS scheduler
-struct threads_sched_result schedule_edf_cbs(struct threads_sched_args args)
+static struct threads_sched_result schedule_edf_cbs(struct threads_sched_args args)
 {
     struct threads_sched_result r;
 
     // check missed deadline for hard tasks
-    struct thread *missed_deadline = __check_deadline_miss(args.run_queue, args.current_time);
+    struct thread *missed_deadline = __check_deadline_miss(args.current_time);
     if(missed_deadline != NULL && missed_deadline->cbs.is_hard_rt){
         r.scheduled_thread_list_member = &missed_deadline->thread_list;
         r.allocated_time = 0;
@@ -306,70 +632,54 @@ struct threads_sched_result schedule_edf_cbs(struct threads_sched_args args)
     // empty runqueue, find sleep time
     if (list_empty(args.run_queue)) {
         r.scheduled_thread_list_member = args.run_queue;
-        
-        int time = -1;
-        struct release_queue_entry *timeth;
-        list_for_each_entry(timeth, args.release_queue, thread_list){
-            if(time == -1 && timeth->release_time > args.current_time){
-                time = timeth->release_time - args.current_time;
-                continue;
-            }
-            
-            if(time > timeth->release_time - args.current_time && timeth->release_time > args.current_time){
-                time = timeth->release_time - args.current_time;
-            }
-        }
         // time = 1;
-        r.allocated_time = time;
+        r.allocated_time = __sleep_time(args.release_queue, args.current_time);
         return r;
     }
 
     struct thread *th;
     // toggle throttle: replenish
-    list_for_each_entry(th, args.run_queue, thread_list){
-        if(!th->cbs.is_hard_rt){
-            if(th->cbs.is_throttled && th->current_deadline <= args.current_time){
-                th->cbs.is_throttled = 0;
-                th->current_deadline = args.current_time + th->period;
-                th->cbs.remaining_budget = th->cbs.budget;
-            }
-        }
+    while((th = heap_top(&throttled)) != NULL && th->current_deadline <= args.current_time){
+        heap_pop(&throttled);
+        th->cbs.is_throttled = 0;
+        th->current_deadline = args.current_time + th->period;
+        th->cbs.remaining_budget = th->cbs.budget;
+        th->cbs.spent = 0;
+        heap_push(&edf_ready, th);
+        heap_fix(&deadlines, th->dl_index);
+        trace_record(TRACE_REPLENISH, th->ID, args.current_time, th->current_deadline);
     }
 
     // toggle throttle: throttle
-    list_for_each_entry(th, args.run_queue, thread_list){
-        if(!th->cbs.is_hard_rt && !th->cbs.is_throttled){
+    list_for_each_entry(th, &soft_threads, cbs.soft_list){
+        if(!th->cbs.is_throttled){
             if(th->cbs.remaining_budget > 0 && th->current_deadline - args.current_time > 0){
                 if(th->cbs.remaining_budget * th->period >  th->cbs.budget * (args.current_time-th->current_deadline)){
                     th->current_deadline = args.current_time + th->period;
                     th->cbs.remaining_budget = th->cbs.budget;
+                    th->cbs.spent = 0;
+                    heap_fix(&edf_ready, th->rq_index);
+                    heap_fix(&deadlines, th->dl_index);
                 }
             }
-            if(th->cbs.remaining_budget <= 0) th->cbs.is_throttled = 1;
+            if(th->cbs.remaining_budget <= 0){
+                heap_remove(&edf_ready, th->rq_index);
+                th->cbs.is_throttled = 1;
+                heap_push(&throttled, th);
+                trace_record(TRACE_THROTTLE, th->ID, args.current_time, th->current_deadline);
+            }
         }
     }
 
     // now choose
-    struct thread *candidate = NULL;
-    list_for_each_entry(th, args.run_queue, thread_list){
-        if(th->cbs.is_throttled) continue;
-        if(candidate == NULL || __edf_thread_cmp(th, candidate)) candidate = th;
-    }
+    struct thread *candidate = heap_top(&edf_ready);
 
     // if none selected -> all throttled soft tasks
-    struct release_queue_entry *rth;
     int ttime = -1;
     if(candidate == NULL){
-        list_for_each_entry(rth, args.release_queue, thread_list){
-            if(ttime == -1 || rth->release_time - args.current_time < ttime){
-                ttime = rth->release_time - args.current_time;
-            }
-        }
-
-        list_for_each_entry(th, args.run_queue, thread_list){
-            if(!th->cbs.is_throttled && th->current_deadline > args.current_time && th->current_deadline - args.current_time < ttime){
-                ttime = th->current_deadline - args.current_time;
-            }
+        if(!heap_empty(args.release_queue)){
+            struct release_queue_entry *rth = heap_top(args.release_queue);
+            ttime = rth->release_time - args.current_time;
         }
         r.scheduled_thread_list_member = args.run_queue;
         r.allocated_time = (ttime == -1)? 1: ttime;
@@ -379,38 +689,435 @@ struct threads_sched_result schedule_edf_cbs(struct threads_sched_args args)
     // time allocation
     int temp_time = candidate->remaining_time;
     if(!candidate->cbs.is_hard_rt){
-        if(candidate->cbs.remaining_budget <= temp_time) temp_time = candidate->cbs.remaining_budget;
+        int budget_time = __budget_time(candidate);
+        if(budget_time <= temp_time) temp_time = budget_time;
     }
 
     // timeslice: release queue
-    list_for_each_entry(rth, args.release_queue, thread_list){
-        th = rth->thrd;
-        if(!th->cbs.is_throttled && __edf_thread_cmp(candidate, th) < 1 && rth->release_time - args.current_time < temp_time){
-            temp_time = rth->release_time - args.current_time;
-        }
-    }
+    temp_time = __earliest_release(args.release_queue, 0, args.current_time + temp_time,
+                                   __edf_preempts, candidate) - args.current_time;
 
     // timeslice: throttled tasks
-    list_for_each_entry(th, args.run_queue, thread_list){
-        if(th->cbs.is_throttled && th->current_deadline > args.current_time){
-            if(th->current_deadline - args.current_time < temp_time){
-                temp_time = th->current_deadline - args.current_time;
-            }
-        }
-    }
+    temp_time = __earliest_replenish(&throttled, 0, args.current_time,
+                                     args.current_time + temp_time) - args.current_time;
 
     r.allocated_time = (temp_time > 0)? temp_time : 1;
     r.scheduled_thread_list_member = &candidate->thread_list;
 
-    // notify the throttle task
-    // TO DO
+    return r;
+}
 
-    // first check if there is any thread has missed its current deadline
-    // TO DO
-    
-    // handle the case where run queue is empty
-    // TO DO
+//  EDF_CBS with GRUB reclaiming
+static struct threads_sched_result schedule_edf_grub(struct threads_sched_args args)
+{
+    struct threads_sched_result r;
 
+    __grub_expire(args.current_time);
+    reclaiming = 1;
+    r = schedule_edf_cbs(args);
+    reclaiming = 0;
     return r;
 }
-#endif
\ No newline at end of file
+
+/* EDF with Virtual Deadlines, mixed criticality */
+
+// Every job is trusted to finish within mc.wcet_lo. While none has
+// overrun (low-criticality mode) a high-criticality thread competes with
+// its deadline scaled by vd_scale, so it runs early enough that, should
+// it need all of mc.wcet_hi, the rest still fits before its real
+// deadline. The first high job found past wcet_lo unfinished switches to
+// high-criticality mode: the low threads' jobs are dropped as they come
+// up and the high ones go by their real deadlines. Once nothing is left
+// to run the system is back in low mode. A low job past its own budget
+// is dropped in either mode. Utilizations are in 1/VD_ONE.
+static int vd_mode = CRIT_LO;
+static uint64 vd_lo = 0, vd_hi_lo = 0, vd_hi_hi = 0;
+// VD_ONE when the worst case fits plain EDF, which never needs high mode
+static int vd_scale = VD_ONE;
+// Queued jobs wait in vd_ready in the order they compete in the current
+// mode, or on vd_dropping, in run queue order, if they are to be
+// dropped (mc.dropped set). A mode change or a new scale re-keys the
+// high threads, and vd_ready is then rebuilt once at the next decision.
+// High jobs that have run past wcet_lo are kept on vd_overrun.
+static int vd_stale = 0;
+static LIST_HEAD(vd_dropping);
+static LIST_HEAD(vd_overrun);
+
+static uint64 __vd_util(int wcet, int deadline)
+{
+    return ((uint64)wcet * VD_ONE + deadline - 1) / deadline;
+}
+
+// add t to the utilizations the scale comes from, or take it out; a set
+// that fails the test runs with real deadlines
+static void __vd_count(struct thread *t, int in)
+{
+    uint64 *lo = t->mc.level == CRIT_HI ? &vd_hi_lo : &vd_lo;
+    uint64 u = __vd_util(t->mc.wcet_lo, t->deadline);
+    uint64 hi = t->mc.level == CRIT_HI ? __vd_util(t->mc.wcet_hi, t->deadline) : 0;
+    int scale = vd_scale;
+
+    if (in) {
+        *lo += u;
+        vd_hi_hi += hi;
+    } else {
+        *lo -= u;
+        vd_hi_hi -= hi;
+    }
+    t->mc.counted = in;
+    vd_scale = edf_vd_scale(vd_lo, vd_hi_lo, vd_hi_hi);
+    if (vd_scale < 0)
+        vd_scale = VD_ONE;
+    if (vd_scale != scale)
+        vd_stale = 1;
+}
+
+// relative deadline t's jobs compete with in the current mode, rounded
+// up as low mode relies on it being no earlier than scaled
+static int __vd_relative(struct thread *t)
+{
+    if (vd_mode == CRIT_LO && t->mc.level == CRIT_HI)
+        return ((uint64)t->deadline * vd_scale + VD_ONE - 1) / VD_ONE;
+    return t->deadline;
+}
+
+static int __vd_deadline(struct thread *t)
+{
+    return t->current_deadline - t->deadline + __vd_relative(t);
+}
+
+static int __vd_before(struct thread *a, struct thread *b)
+{
+    if (__vd_deadline(a) != __vd_deadline(b))
+        return __vd_deadline(a) < __vd_deadline(b);
+    return a->ID < b->ID;
+}
+
+static int __vd_less(void *a, void *b)
+{
+    return __vd_before(a, b);
+}
+
+static struct heap vd_ready = HEAP_INIT(__vd_less, __ready_moved);
+
+static void __vd_drop(struct thread *t)
+{
+    t->mc.dropped = 1;
+    list_add_tail(&t->mc.list, &vd_dropping);
+}
+
+// a low job in high mode is only queued to be dropped
+static void __vd_queue(struct thread *t)
+{
+    if (vd_mode == CRIT_HI && t->mc.level == CRIT_LO)
+        __vd_drop(t);
+    else
+        heap_push(&vd_ready, t);
+}
+
+static void __vd_unqueue(struct thread *t)
+{
+    if (t->mc.dropped) {
+        t->mc.dropped = 0;
+        list_del(&t->mc.list);
+    } else {
+        heap_remove(&vd_ready, t->rq_index);
+    }
+}
+
+static void __vd_rebuild(struct list_head *run_queue)
+{
+    struct thread *th;
+
+    while (!heap_empty(&vd_ready))
+        heap_pop(&vd_ready);
+    list_for_each_entry(th, run_queue, thread_list)
+        if (!th->mc.dropped)
+            __vd_queue(th);
+    vd_stale = 0;
+}
+
+// the job must stop here to be checked against its budget
+static int __vd_budget(struct thread *t)
+{
+    if (t->mc.level == CRIT_LO || (vd_mode == CRIT_LO && vd_scale < VD_ONE))
+        return t->mc.wcet_lo - t->mc.executed;
+    return t->remaining_time;
+}
+
+static void __vd_release(struct thread *t)
+{
+    if (!t->mc.counted)
+        __vd_count(t, 1);
+    t->mc.executed = 0;
+    t->mc.dropped = 0;
+    __vd_queue(t);
+    if (t->is_real_time)
+        heap_push(&deadlines, t);
+}
+
+// called with n at 0 when t exits
+static void __vd_finish(struct thread *t)
+{
+    __vd_unqueue(t);
+    if (t->is_real_time)
+        heap_remove(&deadlines, t->dl_index);
+    if (t->mc.level == CRIT_HI && t->mc.executed >= t->mc.wcet_lo)
+        list_del(&t->mc.list);
+    t->mc.executed = 0;
+    if (t->n <= 0 && t->mc.counted)
+        __vd_count(t, 0);
+}
+
+// only ever called on the thread just picked, so never one to drop
+static void __vd_block(struct thread *t)
+{
+    heap_remove(&vd_ready, t->rq_index);
+    if (t->is_real_time)
+        heap_remove(&deadlines, t->dl_index);
+}
+
+static void __vd_wake(struct thread *t)
+{
+    __vd_queue(t);
+    if (t->is_real_time)
+        heap_push(&deadlines, t);
+}
+
+// the running job may just have used up its wcet_lo: a low one is then
+// dropped, a high one may switch the mode at the next decision
+static void __vd_tick(struct thread *t, int elapsed)
+{
+    int before = t->mc.executed;
+
+    t->mc.executed += elapsed;
+    if (before >= t->mc.wcet_lo || t->mc.executed < t->mc.wcet_lo)
+        return;
+    if (t->mc.level == CRIT_HI) {
+        list_add_tail(&t->mc.list, &vd_overrun);
+    } else {
+        heap_remove(&vd_ready, t->rq_index);
+        __vd_drop(t);
+    }
+}
+
+static int __vd_preempts(struct release_queue_entry *e, void *candidate)
+{
+    struct thread *t = e->thrd;
+    int d = e->release_time + __vd_relative(t);
+
+    if (vd_mode == CRIT_HI && t->mc.level == CRIT_LO)
+        return 0;
+    if (d != __vd_deadline(candidate))
+        return d < __vd_deadline(candidate);
+    return t->ID < ((struct thread *)candidate)->ID;
+}
+
+static struct threads_sched_result schedule_edf_vd(struct threads_sched_args args)
+{
+    struct threads_sched_result r;
+    struct thread *th, *candidate;
+
+    if (list_empty(args.run_queue)) {
+        if (vd_mode == CRIT_HI)
+            trace_record(TRACE_MODE, 0, args.current_time, CRIT_LO);
+        vd_mode = CRIT_LO;
+        r.scheduled_thread_list_member = args.run_queue;
+        r.allocated_time = __sleep_time(args.release_queue, args.current_time);
+        return r;
+    }
+
+    if (vd_mode == CRIT_LO && vd_scale < VD_ONE && !list_empty(&vd_overrun)) {
+        th = list_entry(vd_overrun.next, struct thread, mc.list);
+        vd_mode = CRIT_HI;
+        vd_stale = 1;
+        trace_record(TRACE_MODE, th->ID, args.current_time, CRIT_HI);
+    }
+    if (vd_stale)
+        __vd_rebuild(args.run_queue);
+
+    // dropped rather than reported late
+    if (!list_empty(&vd_dropping)) {
+        th = list_entry(vd_dropping.next, struct thread, mc.list);
+        r.scheduled_thread_list_member = &th->thread_list;
+        r.allocated_time = 0;
+        return r;
+    }
+    if ((th = __check_deadline_miss(args.current_time)) != NULL) {
+        r.scheduled_thread_list_member = &th->thread_list;
+        r.allocated_time = 0;
+        return r;
+    }
+
+    candidate = heap_top(&vd_ready);
+    int temp_time = candidate->remaining_time;
+    if (__vd_budget(candidate) < temp_time)
+        temp_time = __vd_budget(candidate);
+    temp_time = __earliest_release(args.release_queue, 0, args.current_time + temp_time,
+                                   __vd_preempts, candidate) - args.current_time;
+
+    r.scheduled_thread_list_member = &candidate->thread_list;
+    r.allocated_time = temp_time > 0 ? temp_time : 1;
+    return r;
+}
+
+/* Multi-Level Feedback Queue */
+
+// A thread starts at level 0 and drops a level whenever it runs for the
+// whole quantum of its level; one that finishes its burst sooner keeps
+// its level, so short bursts stay ahead of long-running threads without
+// knowing processing_time. Every MLFQ_BOOST ticks all threads are back
+// at level 0, so the long-running ones are not starved. FIFO within a
+// level; the release of a thread of a higher level preempts.
+#define MLFQ_LEVELS 3
+#define MLFQ_BOOST 50
+
+static int mlfq_quantum[MLFQ_LEVELS] = { 2, 4, 8 };
+// time of the last decision, to tell which boost period it is in
+static int mlfq_now = 0;
+
+// t's level, reset if a boost has happened since it was last set
+static int __mlfq_level(struct thread *t)
+{
+    int epoch = mlfq_now / MLFQ_BOOST;
+    if (t->mlfq.epoch != epoch) {
+        t->mlfq.epoch = epoch;
+        t->mlfq.level = 0;
+        t->mlfq.used = 0;
+    }
+    return t->mlfq.level;
+}
+
+static void __mlfq_tick(struct thread *t, int elapsed)
+{
+    t->mlfq.used += elapsed;
+    if (t->mlfq.used >= mlfq_quantum[t->mlfq.level]) {
+        if (t->mlfq.level < MLFQ_LEVELS - 1)
+            t->mlfq.level++;
+        t->mlfq.used = 0;
+    }
+}
+
+static void __mlfq_finish(struct thread *t)
+{
+    t->mlfq.used = 0;
+}
+
+static int __mlfq_preempts(struct release_queue_entry *e, void *candidate)
+{
+    return __mlfq_level(e->thrd) < __mlfq_level(candidate);
+}
+
+static struct threads_sched_result schedule_mlfq(struct threads_sched_args args)
+{
+    struct threads_sched_result r;
+    struct thread *candidate = NULL;
+    struct thread *th = NULL;
+
+    mlfq_now = args.current_time;
+    list_for_each_entry(th, args.run_queue, thread_list) {
+        int level = __mlfq_level(th);
+        if (candidate == NULL || level < candidate->mlfq.level)
+            candidate = th;
+    }
+
+    if (candidate == NULL) {
+        r.scheduled_thread_list_member = args.run_queue;
+        r.allocated_time = __sleep_time(args.release_queue, args.current_time);
+        return r;
+    }
+
+    int temp_time = mlfq_quantum[candidate->mlfq.level] - candidate->mlfq.used;
+    if (candidate->remaining_time < temp_time)
+        temp_time = candidate->remaining_time;
+    temp_time = __earliest_release(args.release_queue, 0, args.current_time + temp_time,
+                                   __mlfq_preempts, candidate) - args.current_time;
+
+    r.scheduled_thread_list_member = &candidate->thread_list;
+    r.allocated_time = temp_time > 0 ? temp_time : 1;
+    return r;
+}
+
+static int __dm_admit(struct rt_task *ts, int n)
+{
+    return rta_dm(ts, n) == 0;
+}
+
+struct thread_sched_ops sched_default = {
+    .name = "DEFAULT",
+    .pick = schedule_default,
+};
+
+struct thread_sched_ops sched_hrrn = {
+    .name = "HRRN",
+    .pick = schedule_hrrn,
+};
+
+struct thread_sched_ops sched_priority_rr = {
+    .name = "PRIORITY_RR",
+    .pick = schedule_priority_rr,
+};
+
+struct thread_sched_ops sched_mlfq = {
+    .name = "MLFQ",
+    .pick = schedule_mlfq,
+    .on_finish = __mlfq_finish,
+    .on_tick = __mlfq_tick,
+};
+
+struct thread_sched_ops sched_dm = {
+    .name = "DM",
+    .pick = schedule_dm,
+    .on_release = __dm_release,
+    .on_finish = __dm_finish,
+    .on_tick = __dm_tick,
+    .on_block = __dm_block,
+    .on_wake = __dm_wake,
+    .on_boost = __dm_boost,
+    .admit = __dm_admit,
+};
+
+struct thread_sched_ops sched_edf_cbs = {
+    .name = "EDF_CBS",
+    .pick = schedule_edf_cbs,
+    .on_release = __edf_release,
+    .on_finish = __edf_finish,
+    .on_tick = __edf_tick,
+    .on_block = __edf_block,
+    .on_wake = __edf_wake,
+    .admit = edf_feasible,
+};
+
+struct thread_sched_ops sched_edf_grub = {
+    .name = "EDF_GRUB",
+    .pick = schedule_edf_grub,
+    .on_release = __grub_release,
+    .on_finish = __grub_finish,
+    .on_tick = __grub_tick,
+    .on_block = __edf_block,
+    .on_wake = __edf_wake,
+    .admit = edf_feasible,
+};
+
+struct thread_sched_ops sched_edf_vd = {
+    .name = "EDF_VD",
+    .pick = schedule_edf_vd,
+    .on_release = __vd_release,
+    .on_finish = __vd_finish,
+    .on_tick = __vd_tick,
+    .on_block = __vd_block,
+    .on_wake = __vd_wake,
+    .admit = edf_vd_feasible,
+};
+
+struct thread_sched_ops *thread_schedulers[] = {
+    &sched_default,
+    &sched_hrrn,
+    &sched_priority_rr,
+    &sched_mlfq,
+    &sched_dm,
+    &sched_edf_cbs,
+    &sched_edf_grub,
+    &sched_edf_vd,
+    NULL,
+};
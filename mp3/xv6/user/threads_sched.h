@@ -2,6 +2,7 @@
 #define THREADS_SCHE_H_
 
 #include "user/list.h"
+#include "user/heap.h"
 
 struct threads_sched_args {
     // the number of ticks since threading starts
@@ -10,8 +11,9 @@ struct threads_sched_args {
     int time_quantum;
     // the linked list containing all the threads available to be run
     struct list_head *run_queue;
-    // the linked list containing all the threads that will be available later
-    struct list_head *release_queue;
+    // min-heap of release_queue_entry by release_time, the threads that
+    // will be available later
+    struct heap *release_queue;
 };
 
 struct threads_sched_result {
@@ -21,20 +23,39 @@ struct threads_sched_result {
     // the number of ticks allocated for this thread to run
     int allocated_time;
 };
-#ifdef THREAD_SCHEDULER_DEFAULT
-struct threads_sched_result schedule_default(struct threads_sched_args args);
-#endif
-#ifdef THREAD_SCHEDULER_HRRN
-struct threads_sched_result schedule_hrrn (struct threads_sched_args args);
-#endif
-#ifdef THREAD_SCHEDULER_PRIORITY_RR
-struct threads_sched_result schedule_priority_rr(struct threads_sched_args args);
-#endif
-#ifdef THREAD_SCHEDULER_EDF_CBS
-struct threads_sched_result schedule_edf_cbs(struct threads_sched_args args);
-#endif
-#ifdef THREAD_SCHEDULER_DM
-struct threads_sched_result schedule_dm(struct threads_sched_args args);
-#endif
+struct thread;
+struct rt_task;
+
+// A scheduling policy. threads.c calls the hooks, when set, as threads
+// move through the run queue, so a policy can keep its own index of the
+// runnable threads; pick makes every scheduling decision.
+struct thread_sched_ops {
+    char *name;
+    struct threads_sched_result (*pick)(struct threads_sched_args args);
+    // t has been appended to the run queue
+    void (*on_release)(struct thread *t);
+    // t has left the run queue: its cycle finished or it exited
+    void (*on_finish)(struct thread *t);
+    // t ran for elapsed ticks
+    void (*on_tick)(struct thread *t, int elapsed);
+    // t has left the run queue to wait for a mutex, and come back
+    void (*on_block)(struct thread *t);
+    void (*on_wake)(struct thread *t);
+    // t's effective_period changed, in or out of the run queue
+    void (*on_boost)(struct thread *t);
+    // schedulability test for admission control, 1 if ts[0..n) passes
+    int (*admit)(struct rt_task *ts, int n);
+};
+
+extern struct thread_sched_ops sched_default;
+extern struct thread_sched_ops sched_hrrn;
+extern struct thread_sched_ops sched_priority_rr;
+extern struct thread_sched_ops sched_mlfq;
+extern struct thread_sched_ops sched_dm;
+extern struct thread_sched_ops sched_edf_cbs;
+extern struct thread_sched_ops sched_edf_grub;
+extern struct thread_sched_ops sched_edf_vd;
+// every policy above, NULL-terminated
+extern struct thread_sched_ops *thread_schedulers[];
 
 #endif
@@ -0,0 +1,118 @@
+#include "kernel/types.h"
+#include "user/user.h"
+
+// cyclictest-style latency of timer upcalls: arms a timer over and over
+// and measures, with rdtime as the handler's first action, how long after
+// the intended expiry the handler runs. thrdstopus and thrdtimer are
+// wall-clock timers, so the expiry is known to a cycle; thrdstop counts
+// ticks the process has run, whose exact time user space cannot see,
+// and shares its delivery path with thrdstopus. Each timer
+// is measured idle and with NHOGS competing processes; without a hart to
+// itself the process waits out the hogs' time slices. Times in us:
+//   bench: timerlat.<timer>.<idle|load> samples=<n> min=<us> avg=<us> max=<us>
+//   bench: timerlat.<timer>.<idle|load> hist <10us=<n> <100us=<n> <1ms=<n> <10ms=<n> <100ms=<n> >=100ms=<n>
+
+#define NSAMPLES 200
+#define NHOGS 3
+#define DELAY_MIN_US 200
+#define DELAY_SPREAD_US 1000
+#define CYCLES_PER_US 10 // rdtime runs at 10MHz in qemu
+
+static int bounds_us[] = { 10, 100, 1000, 10000, 100000 };
+#define NBUCKETS (sizeof(bounds_us) / sizeof(bounds_us[0]) + 1)
+
+static int context = -1;
+static volatile uint64 fired_at;
+static volatile int fired;
+static uint seed = 1;
+
+static inline uint64 rdtime(void)
+{
+    uint64 t;
+    asm volatile("rdtime %0" : "=r"(t));
+    return t;
+}
+
+static void handler(void *arg)
+{
+    fired_at = rdtime();
+    fired = 1;
+    thrdresume(context);
+}
+
+// delays spread over a tick's worth of phases rather than locked to it
+static int next_delay(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return DELAY_MIN_US + (seed >> 16) % DELAY_SPREAD_US;
+}
+
+static void hog(void)
+{
+    volatile int k = 0;
+    while (1)
+        k++;
+}
+
+static void measure(int use_thrdtimer, char *load)
+{
+    char *name = use_thrdtimer ? "thrdtimer" : "thrdstopus";
+    int hist[NBUCKETS];
+    uint64 expected, late, min = ~0UL, max = 0, total = 0;
+    int i, b, delay;
+
+    memset(hist, 0, sizeof(hist));
+    for (i = 0; i < NSAMPLES; i++) {
+        delay = next_delay();
+        fired = 0;
+        // the kernel reads mtime a few cycles later, so this errs early
+        expected = rdtime() + (uint64)delay * CYCLES_PER_US;
+        if (use_thrdtimer)
+            thrdtimer(delay, &context, handler, 0);
+        else
+            thrdstopus(delay, &context, handler, 0);
+        while (!fired)
+            ;
+        late = fired_at > expected ? fired_at - expected : 0;
+        total += late;
+        if (late < min)
+            min = late;
+        if (late > max)
+            max = late;
+        for (b = 0; b < NBUCKETS - 1 && late >= bounds_us[b] * CYCLES_PER_US; b++)
+            ;
+        hist[b]++;
+    }
+
+    printf("bench: timerlat.%s.%s samples=%d min=%d avg=%d max=%d\n", name, load, NSAMPLES,
+           (int)(min / CYCLES_PER_US), (int)(total / NSAMPLES / CYCLES_PER_US), (int)(max / CYCLES_PER_US));
+    printf("bench: timerlat.%s.%s hist", name, load);
+    for (b = 0; b < NBUCKETS - 1; b++) {
+        if (bounds_us[b] < 1000)
+            printf(" <%dus=%d", bounds_us[b], hist[b]);
+        else
+            printf(" <%dms=%d", bounds_us[b] / 1000, hist[b]);
+    }
+    printf(" >=%dms=%d\n", bounds_us[NBUCKETS - 2] / 1000, hist[NBUCKETS - 1]);
+}
+
+int main(int argc, char **argv)
+{
+    int hogs[NHOGS], i;
+
+    printf("timerlat\n");
+    measure(0, "idle");
+    measure(1, "idle");
+    for (i = 0; i < NHOGS; i++) {
+        if ((hogs[i] = fork()) == 0)
+            hog();
+    }
+    measure(0, "load");
+    measure(1, "load");
+    for (i = 0; i < NHOGS; i++) {
+        kill(hogs[i]);
+        wait(0);
+    }
+    cancelthrdstop(context, 1);
+    exit(0);
+}
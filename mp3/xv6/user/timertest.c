@@ -0,0 +1,53 @@
+#include "kernel/types.h"
+#include "user/user.h"
+
+// Arms several thrdtimer timers at once and checks they are delivered in
+// deadline order, each interrupting the main loop with its own context,
+// and that a cancelled one never fires:
+//   timertest: order <ids> cancel=<ok|fail>
+
+#define NTIMERS 4
+
+static int context[NTIMERS];
+static volatile int fired[NTIMERS];
+static volatile int order[NTIMERS];
+static volatile int n;
+
+static void handler(void *arg)
+{
+    int i = (int)(uint64)arg;
+    fired[i]++;
+    order[n++] = i;
+    thrdresume(context[i]);
+}
+
+int main(int argc, char **argv)
+{
+    // armed out of order; timer 3 is cancelled before it expires
+    int delay_us[NTIMERS] = { 30000, 10000, 20000, 25000 };
+    int id[NTIMERS], i, left, again, start;
+
+    for (i = 0; i < NTIMERS; i++) {
+        context[i] = -1;
+        if ((id[i] = thrdtimer(delay_us[i], &context[i], handler, (void *)(uint64)i)) < 0) {
+            printf("timertest: thrdtimer failed\n");
+            exit(1);
+        }
+    }
+    left = cancelthrdtimer(id[3]);
+    again = cancelthrdtimer(id[3]);
+
+    // a tick is 100ms, so each timer interrupts the loop on its own
+    start = uptime();
+    while (n < NTIMERS - 1 && uptime() - start < 10)
+        ;
+    sleep(1);
+
+    printf("timertest: order");
+    for (i = 0; i < n; i++)
+        printf(" %d", order[i]);
+    printf(" cancel=%s\n", left > 0 && again < 0 && fired[3] == 0 ? "ok" : "fail");
+    for (i = 0; i < NTIMERS; i++)
+        cancelthrdstop(context[i], 1);
+    exit(0);
+}
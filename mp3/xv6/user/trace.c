@@ -0,0 +1,65 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/trace.h"
+
+// allocated by the first trace_start, every program links this file
+static struct trace_event *ring;
+static uint64 recorded = 0;
+static int enabled = 0;
+
+// clear the ring and start recording
+void trace_start(void)
+{
+    if (ring == 0)
+        ring = (struct trace_event *)malloc(TRACE_EVENTS * sizeof(struct trace_event));
+    recorded = 0;
+    enabled = ring != 0;
+}
+
+void trace_stop(void)
+{
+    enabled = 0;
+}
+
+int trace_on(void)
+{
+    return enabled;
+}
+
+void trace_record(int type, int tid, int time, int arg)
+{
+    if (!enabled)
+        return;
+    struct trace_event *e = &ring[recorded++ % TRACE_EVENTS];
+    e->cycles = trace_cycles();
+    e->time = time;
+    e->arg = arg;
+    e->type = type;
+    e->tid = tid;
+}
+
+// "trace: begin <events> <lost>", a "trace: <hex>" line per event,
+// oldest first, then "trace: end"; one write per line
+void trace_dump(void)
+{
+    static const char digits[] = "0123456789abcdef";
+    char line[8 + 2 * sizeof(struct trace_event) + 1];
+    uint64 i, first = recorded > TRACE_EVENTS ? recorded - TRACE_EVENTS : 0;
+    int j;
+
+    if (!enabled)
+        return;
+    enabled = 0;
+    printf("trace: begin %d %d\n", (int)(recorded - first), (int)first);
+    memmove(line, "trace: ", 7);
+    for (i = first; i < recorded; i++) {
+        unsigned char *b = (unsigned char *)&ring[i % TRACE_EVENTS];
+        for (j = 0; j < sizeof(struct trace_event); j++) {
+            line[7 + 2 * j] = digits[b[j] >> 4];
+            line[8 + 2 * j] = digits[b[j] & 15];
+        }
+        line[7 + 2 * sizeof(struct trace_event)] = '\n';
+        write(1, line, 8 + 2 * sizeof(struct trace_event));
+    }
+    printf("trace: end\n");
+}
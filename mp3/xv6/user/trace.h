@@ -0,0 +1,48 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include "kernel/types.h"
+
+// Scheduling trace: events go into a fixed in-memory ring, newest
+// overwriting oldest, and trace_dump() prints it once at the end so the
+// run itself makes no write calls. rttrace.py on the host reads the
+// dump from the console log.
+
+#define TRACE_EVENTS 4096
+
+#define TRACE_RELEASE 1   // job released, arg = its absolute deadline
+#define TRACE_DISPATCH 2  // arg = allocated time
+#define TRACE_PREEMPT 3   // allocated time used up, arg = remaining time
+#define TRACE_FINISH 4    // job completed, arg = jobs left
+#define TRACE_EXIT 5      // thread left the system
+#define TRACE_MISS 6      // deadline miss, arg = the deadline
+#define TRACE_THROTTLE 7  // CBS budget exhausted, arg = replenish time
+#define TRACE_REPLENISH 8 // CBS budget refilled, arg = new deadline
+#define TRACE_IDLE 9      // nothing to run, arg = sleep length
+#define TRACE_PICK 10     // policy decision, arg = cycles it took
+#define TRACE_DROP 11     // job abandoned unfinished, arg = time it had left
+#define TRACE_MODE 12     // EDF_VD criticality mode change, arg = CRIT_LO or CRIT_HI
+
+// one record, dumped as its 24 bytes little-endian in hex
+struct trace_event {
+    uint64 cycles; // rdtime when recorded
+    int time;      // threading time, in ticks
+    int arg;
+    int type;
+    int tid;       // thread ID, 0 for none
+};
+
+void trace_start(void);
+void trace_stop(void);
+int trace_on(void);
+void trace_record(int type, int tid, int time, int arg);
+void trace_dump(void);
+
+static inline uint64 trace_cycles(void)
+{
+    uint64 t;
+    asm volatile("rdtime %0" : "=r"(t));
+    return t;
+}
+
+#endif // TRACE_H_
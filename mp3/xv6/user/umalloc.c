@@ -21,8 +21,111 @@ typedef union header Header;
 static Header base;
 static Header *freep;
 
+// Per-thread arenas for small allocations. A thread library gives each
+// thread an arena and points malloc_arena at the running thread's one;
+// small requests are served from it by size class and fall back to the
+// global free list when it is full. Arena blocks carry ARENA_TAG | class
+// in s.size and their arena in s.ptr, so free() can route them back.
+
+#define ARENA_TAG    0x80000000
+#define ARENA_NCLASS 4
+
+static const uint arena_units[ARENA_NCLASS] = { 2, 3, 5, 9 }; // header included
+
+struct arena {
+  Header *free[ARENA_NCLASS]; // freed blocks, linked through s.ptr
+  Header *cur;                // next never-used unit
+  Header *end;
+  int live;                   // blocks handed out and not yet freed
+  int dead;                   // owner is gone, release when live drops to 0
+};
+
+struct arena *malloc_arena;
+
+static void gfree(void *ap);
+static void *gmalloc(uint nbytes);
+
+static void*
+arena_alloc(struct arena *a, uint nunits)
+{
+  Header *hp;
+  int c;
+
+  for(c = 0; c < ARENA_NCLASS && arena_units[c] < nunits; c++)
+    ;
+  if(c == ARENA_NCLASS)
+    return 0;
+  if((hp = a->free[c]) != 0)
+    a->free[c] = hp->s.ptr;
+  else if(a->cur + arena_units[c] <= a->end){
+    hp = a->cur;
+    a->cur += arena_units[c];
+  } else
+    return 0;
+  hp->s.ptr = (Header*)a;
+  hp->s.size = ARENA_TAG | c;
+  a->live++;
+  return (void*)(hp + 1);
+}
+
+static void
+arena_free(Header *bp)
+{
+  struct arena *a = (struct arena*)bp->s.ptr;
+  int c = bp->s.size & ~ARENA_TAG;
+
+  bp->s.ptr = a->free[c];
+  a->free[c] = bp;
+  if(--a->live == 0 && a->dead)
+    gfree(a);
+}
+
+// nbytes of small-object space, taken from the global heap.
+struct arena*
+arena_create(uint nbytes)
+{
+  struct arena *a;
+  uint nunits;
+
+  nunits = (sizeof(struct arena) + sizeof(Header) - 1)/sizeof(Header);
+  a = gmalloc((nunits + nbytes/sizeof(Header)) * sizeof(Header));
+  if(a == 0)
+    return 0;
+  memset(a, 0, sizeof(*a));
+  a->cur = (Header*)a + nunits;
+  a->end = a->cur + nbytes/sizeof(Header);
+  return a;
+}
+
+// blocks still in use (e.g. handed to another thread) keep
+// the arena alive until they are freed.
+void
+arena_destroy(struct arena *a)
+{
+  if(a == 0)
+    return;
+  if(malloc_arena == a)
+    malloc_arena = 0;
+  a->dead = 1;
+  if(a->live == 0)
+    gfree(a);
+}
+
 void
 free(void *ap)
+{
+  Header *bp = (Header*)ap - 1;
+
+  if(ap == 0)
+    return;
+  if(bp->s.size & ARENA_TAG)
+    arena_free(bp);
+  else
+    gfree(ap);
+}
+
+static void
+gfree(void *ap)
 {
   Header *bp, *p;
 
@@ -56,12 +159,25 @@ morecore(uint nu)
     return 0;
   hp = (Header*)p;
   hp->s.size = nu;
-  free((void*)(hp + 1));
+  gfree((void*)(hp + 1));
   return freep;
 }
 
 void*
 malloc(uint nbytes)
+{
+  void *p;
+
+  if(malloc_arena){
+    p = arena_alloc(malloc_arena, (nbytes + sizeof(Header) - 1)/sizeof(Header) + 1);
+    if(p)
+      return p;
+  }
+  return gmalloc(nbytes);
+}
+
+static void*
+gmalloc(uint nbytes)
 {
   Header *p, *prevp;
   uint nunits;
@@ -27,6 +27,13 @@ int uptime(void);
 int thrdstop(int delay, int *thrdstop_context_id_ptr, void (*handler)(void *), void *handler_arg);
 int thrdresume(int thrdstop_context_id);
 int cancelthrdstop( int thrdstop_context_id, int is_exit);
+int thrdstopus(int delay_us, int *thrdstop_context_id_ptr, void (*handler)(void *), void *handler_arg);
+int setaffinity(int hart);
+int thrdtimer(int delay_us, int *thrdstop_context_id_ptr, void (*handler)(void *), void *handler_arg);
+int cancelthrdtimer(int timer_id);
+int sched_deadline(int runtime, int deadline, int period);
+uint64 cpucycles(void);
+int schedstat(int hart, uint64 *stat);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -44,3 +51,9 @@ void free(void*);
 int atoi(const char*);
 int memcmp(const void *, const void *, uint);
 void *memcpy(void *, const void *, uint);
+
+// umalloc.c
+struct arena;
+extern struct arena *malloc_arena;
+struct arena *arena_create(uint);
+void arena_destroy(struct arena*);
@@ -40,4 +40,11 @@ entry("uptime");
 entry("thrdstop");
 entry("thrdresume");
 entry("cancelthrdstop");
+entry("thrdstopus");
+entry("setaffinity");
+entry("sched_deadline");
+entry("thrdtimer");
+entry("cancelthrdtimer");
+entry("cpucycles");
+entry("schedstat");
 